@@ -0,0 +1,60 @@
+#pragma once
+
+#include <fftw3.h>
+
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <new>
+
+// One block, aligned for FFTW and the widest SIMD loads, carved into the buffers a
+// solver needs for its whole life. Buffers are never freed individually, so once a
+// solver is constructed its period loop does not touch the heap.
+class Arena {
+public:
+    static constexpr size_t alignment = 64;
+
+    // Room a buffer of count T takes in the arena.
+    template<typename T>
+    static constexpr size_t bytesFor(size_t count) {
+        return (count * sizeof(T) + alignment - 1) / alignment * alignment;
+    }
+
+    // fftw_malloc only aligns for the SIMD FFTW was built with (16 or 32 bytes), so the block is
+    // over-allocated and its start rounded up to alignment.
+    explicit Arena(size_t bytes) : capacity(bytes), block(static_cast<std::byte *>(fftw_malloc(bytes + alignment))) {
+        if (!block) {
+            throw std::bad_alloc();
+        }
+        void *start = block.get();
+        size_t space = bytes + alignment;
+        base = static_cast<std::byte *>(std::align(alignment, bytes, start, space));
+    }
+
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    template<typename T>
+    T *allocate(size_t count) {
+        assert(used + bytesFor<T>(count) <= capacity);
+        T *result = reinterpret_cast<T *>(base + used);
+        used += bytesFor<T>(count);
+        return result;
+    }
+
+    [[nodiscard]] size_t bytes() const {
+        return capacity;
+    }
+
+private:
+    struct Free {
+        void operator()(std::byte *ptr) const {
+            fftw_free(ptr);
+        }
+    };
+
+    const size_t capacity;
+    size_t used = 0;
+    std::unique_ptr<std::byte[], Free> block;
+    std::byte *base = nullptr;
+};
@@ -0,0 +1,282 @@
+#include "batch.h"
+#include "period_aggregator.h"
+#include "sales_reader.h"
+#include "scenario_sweep.h"
+#include "solve_cache.h"
+#include "work_stealing_pool.h"
+
+#include <filesystem>
+
+std::vector<Product> readCatalogue(std::string filename, Period period) {
+    std::ifstream file(filename);
+    std::vector<Product> result;
+    if (!file.is_open()) {
+        return {};
+    }
+    std::string line;
+    if (!(getline(file, line) && line.find("Purchase Forecast catalogue") != std::string::npos)) {
+        return {};
+    }
+    const auto dir = std::filesystem::path(filename).parent_path();
+    while (getline(file, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        std::istringstream input(line);
+        Product product{};
+        double inflation{};
+        input >> product.sku >> product.params.purchasePrice >> product.params.profitOfOnePurchase
+              >> product.params.storageCosts >> product.params.deficitCoefficient >> inflation
+              >> product.currentStock >> product.gauss.mean >> product.gauss.sigma;
+        if (!input) {
+            std::cerr << "Skipping malformed catalogue line: " << line << "\n";
+            continue;
+        }
+        product.params.inflation = 1.0 - inflation / 100.0;
+        std::string history;
+        if (input >> history) {
+            auto path = std::filesystem::path(history);
+            if (path.is_relative()) {
+                path = dir / path;
+            }
+            std::vector<MalformedLine> errors;
+            PeriodAggregator aggregator(period);
+            auto rows = readSalesFile(path.string(), [&aggregator](time_t date, double y) {
+                aggregator.add(date, y);
+            }, &errors);
+            if (!errors.empty()) {
+                std::cerr << path.string() << ": " << errors.size() << " malformed lines skipped, first at line "
+                          << errors.front().line << "\n";
+            }
+            if (rows == 0) {
+                std::cerr << "File wasn't correct: " << path.string() << "\n";
+            } else {
+                product.gaussVec = aggregator.periods();
+            }
+        }
+        result.push_back(std::move(product));
+    }
+    return result;
+}
+
+namespace {
+
+template<typename Demand, Precision precision>
+ProductResult solveWith(const Product &product, int periodsNum, std::shared_ptr<FftWorkspace> workspace,
+                        const SolveOptions &options, Demand demand) {
+    using Calculator = BasicTaskCalculator<Demand, precision>;
+    using Workspace = typename Calculator::Workspace;
+    ProductResult result(product.sku);
+    auto gauss_for_init = gridDistribution(product.gauss, product.gaussVec);
+    if (gauss_for_init.sigma <= 0.0 || periodsNum < 1) {
+        return result;
+    }
+    // The workers' workspaces are double; the reduced precisions plan float ones per solve.
+    auto workspaceFor = [&](size_t dotsNum) -> std::shared_ptr<Workspace> {
+        if constexpr (precision == Precision::full) {
+            if (dotsNum == workspace->n) {
+                return workspace;
+            }
+        }
+        return std::make_shared<Workspace>(dotsNum, workspace->rigor, workspace->mode, workspace->threads);
+    };
+    auto make = [&](std::shared_ptr<Workspace> space) {
+        auto calculator = std::make_unique<Calculator>(product.params, gauss_for_init, periodsNum,
+                                                       std::move(space), ValueStorage::rolling, demand);
+        if (!product.gaussVec.empty()) {
+            calculator->setGaussVector(product.gaussVec);
+        }
+        calculator->setConvergence(options.convergence, options.convergence * product.params.purchasePrice);
+        calculator->setThreads(options.threads);
+        return calculator;
+    };
+    auto run = [](Calculator &calculator) {
+        while (calculator.calcPeriod()) {
+        }
+        return true;
+    };
+    std::unique_ptr<Calculator> calculator;
+    if (options.grid.enabled()) {
+        std::vector<double> stocks{product.currentStock};
+        stocks.insert(stocks.end(), product.stockLevels.begin(), product.stockLevels.end());
+        calculator = refineGrid(gauss_for_init, options.grid, stocks, result.grid, [&](int dotsNum) {
+            return make(workspaceFor(static_cast<size_t>(dotsNum)));
+        }, run);
+    } else {
+        result.grid.dotsNum = static_cast<int>(workspace->n);
+        result.grid.solves = 1;
+        calculator = make(workspaceFor(workspace->n));
+        run(*calculator);
+    }
+    result.y_max = calculator->getMaxY();
+    result.profit_max = calculator->getMaxProfit();
+    result.answer = calculator->getAnswer(product.currentStock);
+    if (!product.stockLevels.empty()) {
+        result.stockAnswers = calculator->getAnswers(product.stockLevels);
+    }
+    if (result.answer) {
+        double order = result.answer->y - product.currentStock;
+        result.order = order < 0.01 ? 0.0 : order;
+    }
+    result.stats = calculator->getStats();
+    result.stationaryPeriod = calculator->getStationaryPeriod();
+    if (options.keepPolicy && result.answer) {
+        result.policy = makeSnapshot(*calculator, product.sku, product.params, options.keepValueFunction);
+    }
+    return result;
+}
+
+template<typename Demand>
+ProductResult solveAt(const Product &product, int periodsNum, std::shared_ptr<FftWorkspace> workspace,
+                      const SolveOptions &options, Demand demand = Demand{}) {
+    switch (options.precision) {
+#ifdef PURCHASE_FORECAST_FLOAT
+        case Precision::mixed:
+            return solveWith<Demand, Precision::mixed>(product, periodsNum, std::move(workspace), options, demand);
+        case Precision::single:
+            return solveWith<Demand, Precision::single>(product, periodsNum, std::move(workspace), options, demand);
+#endif
+        default:
+            break;
+    }
+    return solveWith<Demand, Precision::full>(product, periodsNum, std::move(workspace), options, demand);
+}
+
+template<typename Demand>
+std::vector<ProductResult> sweepWith(const Product &product, const std::vector<TaskParameters> &scenarios,
+                                     int periodsNum, int dotsNum, PlanRigor rigor, FftMode fftMode,
+                                     const SolveOptions &options, Demand demand = Demand{}) {
+    std::vector<ProductResult> results(scenarios.size(), ProductResult(product.sku));
+    auto gauss_for_init = gridDistribution(product.gauss, product.gaussVec);
+    if (gauss_for_init.sigma <= 0.0 || periodsNum < 1 || scenarios.empty()) {
+        return results;
+    }
+    BasicScenarioSweep<Demand> sweep(scenarios, gauss_for_init, periodsNum, dotsNum, rigor, fftMode, options.threads,
+                                     demand);
+    if (!product.gaussVec.empty()) {
+        sweep.setGaussVector(product.gaussVec);
+    }
+    sweep.setThreads(options.threads);
+    while (sweep.calcPeriod()) {
+    }
+    auto answers = sweep.getAnswers(product.currentStock);
+    for (size_t k = 0; k < scenarios.size(); ++k) {
+        auto &result = results[k];
+        result.y_max = sweep.getMaxY(k);
+        result.profit_max = sweep.getMaxProfit(k);
+        result.answer = answers[k];
+        if (result.answer) {
+            double order = result.answer->y - product.currentStock;
+            result.order = order < 0.01 ? 0.0 : order;
+        }
+        result.grid.dotsNum = dotsNum;
+        result.grid.solves = 1;
+    }
+    return results;
+}
+
+EmpiricalDemand historyDemand(const Product &product) {
+    std::vector<double> totals;
+    for (const auto &it: product.gaussVec) {
+        totals.push_back(it.mean);
+    }
+    return EmpiricalDemand(makeEmpiricalShape(totals));
+}
+
+ProductResult solveUncached(const Product &product, int periodsNum, std::shared_ptr<FftWorkspace> workspace,
+                            const SolveOptions &options) {
+    switch (product.distribution) {
+        case Distribution::lognormal:
+            return solveAt<LognormalDemand>(product, periodsNum, std::move(workspace), options);
+        case Distribution::negativeBinomial:
+            return solveAt<NegativeBinomialDemand>(product, periodsNum, std::move(workspace), options);
+        case Distribution::empirical: {
+            if (product.gaussVec.size() < 2) {
+                return ProductResult(product.sku);
+            }
+            return solveAt(product, periodsNum, std::move(workspace), options, historyDemand(product));
+        }
+        case Distribution::gauss:
+            break;
+    }
+    return solveAt<GaussianDemand>(product, periodsNum, std::move(workspace), options);
+}
+
+}
+
+ProductResult solveProduct(const Product &product, int periodsNum, std::shared_ptr<FftWorkspace> workspace,
+                           const SolveOptions &options) {
+    if (!options.cache || options.keepPolicy) {
+        return solveUncached(product, periodsNum, std::move(workspace), options);
+    }
+    const auto key = solveCacheKey(product, periodsNum, static_cast<int>(workspace->n), workspace->mode, options);
+    if (auto cached = options.cache->find(key)) {
+        cached->sku = product.sku;
+        return std::move(*cached);
+    }
+    auto result = solveUncached(product, periodsNum, std::move(workspace), options);
+    if (result.answer) {
+        options.cache->store(key, result);
+    }
+    return result;
+}
+
+std::vector<ProductResult> sweepProduct(const Product &product, const std::vector<TaskParameters> &scenarios,
+                                        int periodsNum, int dotsNum, PlanRigor rigor, FftMode fftMode,
+                                        const SolveOptions &options) {
+    switch (product.distribution) {
+        case Distribution::lognormal:
+            return sweepWith<LognormalDemand>(product, scenarios, periodsNum, dotsNum, rigor, fftMode, options);
+        case Distribution::negativeBinomial:
+            return sweepWith<NegativeBinomialDemand>(product, scenarios, periodsNum, dotsNum, rigor, fftMode,
+                                                     options);
+        case Distribution::empirical: {
+            if (product.gaussVec.size() < 2) {
+                return std::vector<ProductResult>(scenarios.size(),
+                                                  ProductResult(product.sku));
+            }
+            return sweepWith(product, scenarios, periodsNum, dotsNum, rigor, fftMode, options,
+                             historyDemand(product));
+        }
+        case Distribution::gauss:
+            break;
+    }
+    return sweepWith<GaussianDemand>(product, scenarios, periodsNum, dotsNum, rigor, fftMode, options);
+}
+
+std::vector<ProductResult> solveBatch(const std::vector<Product> &products, int periodsNum, int dotsNum,
+                                      unsigned threads, PlanRigor rigor, FftMode fftMode,
+                                      const SolveOptions &options) {
+    std::vector<ProductResult> results(products.size());
+    WorkStealingPool pool(threads);
+    // One set of buffers and plans per worker, reused for every product it solves.
+    std::vector<std::shared_ptr<FftWorkspace>> workspaces(pool.size());
+    pool.run(products.size(), [&](size_t index, unsigned worker) {
+        auto &workspace = workspaces[worker];
+        if (!workspace) {
+            workspace = std::make_shared<FftWorkspace>(dotsNum, rigor, fftMode, options.threads);
+        }
+        results[index] = solveProduct(products[index], periodsNum, workspace, options);
+    });
+    return results;
+}
+
+void writeResults(std::ostream &out, const std::vector<ProductResult> &results) {
+    out << "sku\tstatus\torder\tperiod_profit\ttotal_profit\ty_max\tprofit_max\n";
+    for (const auto &res: results) {
+        out << res.sku << "\t";
+        if (!res.answer) {
+            out << "failed\t\t\t\t\t\n";
+            continue;
+        }
+        out << "ok\t" << res.order << "\t" << res.answer->thisPeriodProfit << "\t" << res.answer->MaxProfit << "\t";
+        for (size_t i = 0; i < res.y_max.size(); ++i) {
+            out << (i ? "," : "") << res.y_max[i];
+        }
+        out << "\t";
+        for (size_t i = 0; i < res.profit_max.size(); ++i) {
+            out << (i ? "," : "") << res.profit_max[i];
+        }
+        out << "\n";
+    }
+}
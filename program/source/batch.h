@@ -0,0 +1,86 @@
+#pragma once
+
+#include "grid_refinement.h"
+#include "manager.h"
+#include "policy_snapshot.h"
+
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct Product {
+    std::string sku;
+    TaskParameters params;
+    GaussDestrParameters gauss;
+    std::vector<GaussDestrParameters> gaussVec;
+    double currentStock;
+    std::vector<double> stockLevels{};      // further starting stocks to answer from the same solve
+    Distribution distribution = Distribution::gauss;
+};
+
+struct ProductResult {
+    ProductResult() = default;
+
+    explicit ProductResult(std::string sku) : sku(std::move(sku)) {
+    }
+
+    std::string sku;
+    std::optional<Answer> answer;
+    double order = 0.0;
+    std::vector<double> y_max;
+    std::vector<double> profit_max;
+    std::vector<std::optional<Answer>> stockAnswers;
+    SolveStats stats;
+    int stationaryPeriod = -1;              // index into y_max where the recursion settled, or -1
+    GridRefinement grid;                    // grid actually solved on
+    std::optional<PolicySnapshot> policy;   // with SolveOptions::keepPolicy
+};
+
+class SolveCache;
+
+// Settings shared by every product of a run.
+struct SolveOptions {
+    // BasicTaskCalculator::setConvergence with this tolerance on y_max (goods) and
+    // convergence * purchasePrice on the value function; 0 solves every period.
+    double convergence = 0.0;
+    // When enabled, the grid is refined to this tolerance (see refineGrid) instead of taking the
+    // workspace's size; the extra workspaces keep its plan rigor and FFT mode.
+    GridTolerance grid;
+    // Threads inside one solve, see BasicTaskCalculator::setThreads; the FFTs follow the workspace.
+    unsigned threads = 1;
+    // Fill ProductResult::policy (see makeSnapshot), with the first-period value function if keepValueFunction.
+    bool keepPolicy = false;
+    bool keepValueFunction = false;
+    // Results are looked up here first and stored after a solve (see solve_cache.h); not used with keepPolicy.
+    SolveCache *cache = nullptr;
+    // Scalar type of solveProduct (see Precision); mixed and single need a PURCHASE_FORECAST_FLOAT
+    // build and are solved in full precision otherwise. sweepProduct is always full.
+    Precision precision = Precision::full;
+};
+
+// Catalogue file: "Purchase Forecast catalogue" on the first line, then one product per line
+//   sku purchasePrice profitOfOnePurchase storageCosts deficitCoefficient inflation cur_stock mean sigma [history]
+// where inflation is in percent and history is a Purchase Forecast file (relative to the catalogue).
+std::vector<Product> readCatalogue(std::string filename, Period period);
+
+// Distribution::empirical takes its shape from the means of gaussVec (the period totals of the
+// history) and fails without at least two periods.
+ProductResult solveProduct(const Product &product, int periodsNum, std::shared_ptr<FftWorkspace> workspace,
+                           const SolveOptions &options = {});
+
+// product solved once for each TaskParameters of scenarios in place of product.params, as one
+// BasicScenarioSweep (a kernel spectrum per period, the value functions transformed as a batch)
+// instead of a solve each. Results are in the order of scenarios; stockLevels, stats and the
+// convergence and grid options are not used, options.threads spreads the scenarios over threads.
+std::vector<ProductResult> sweepProduct(const Product &product, const std::vector<TaskParameters> &scenarios,
+                                        int periodsNum, int dotsNum, PlanRigor rigor = PlanRigor::estimate,
+                                        FftMode fftMode = FftMode::real, const SolveOptions &options = {});
+
+std::vector<ProductResult> solveBatch(const std::vector<Product> &products, int periodsNum, int dotsNum,
+                                      unsigned threads = 0, PlanRigor rigor = PlanRigor::estimate,
+                                      FftMode fftMode = FftMode::real, const SolveOptions &options = {});
+
+void writeResults(std::ostream &out, const std::vector<ProductResult> &results);
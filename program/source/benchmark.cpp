@@ -0,0 +1,287 @@
+#include "manager.h"
+#include "policy_snapshot.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <random>
+#include <string>
+
+namespace {
+
+const char *usage =
+        "Usage: PurchaseForecastBench [--output FILE] [--min-resolution R] [--max-resolution R]\n"
+        "                             [--max-periods P] [--max-rows N] [--min-time SECONDS]\n"
+        "                             [--threads T] [--max-policies N]\n"
+        "\n"
+        "Times GaussConvolution::calculate, ExplicitIntegrator::calculate, a full TaskCalculator\n"
+        "solve, readFile/parsePeriods and loading and querying policy snapshots, and writes the\n"
+        "results as JSON (stdout by default). Defaults sweep grids 2^10..2^22, horizons 1..365\n"
+        "periods, files of 10^3..10^7 rows and snapshots of 10^2..10^4 policies.\n"
+        "With T > 1 every solve is also timed with T threads (see BasicTaskCalculator::setThreads).\n"
+        "Builds with PURCHASE_FORECAST_FLOAT also time the mixed and single precision solves.\n";
+
+using Clock = std::chrono::steady_clock;
+
+struct Measurement {
+    std::string name;
+    std::vector<std::pair<std::string, long long>> params;
+    long long iterations;
+    double seconds;
+};
+
+// Repeats body until at least minTime has passed.
+Measurement measure(std::string name, std::vector<std::pair<std::string, long long>> params,
+                    const std::function<void()> &body, double minTime) {
+    long long iterations = 0;
+    double elapsed = 0.0;
+    auto start = Clock::now();
+    do {
+        body();
+        ++iterations;
+        elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    } while (elapsed < minTime);
+    std::fprintf(stderr, "%-14s", name.c_str());
+    for (const auto &[key, value]: params) {
+        std::fprintf(stderr, " %s=%lld", key.c_str(), value);
+    }
+    std::fprintf(stderr, "  %.6g s\n", elapsed / static_cast<double>(iterations));
+    return {std::move(name), std::move(params), iterations, elapsed};
+}
+
+const TaskParameters benchParams{10.0, 1.0, 0.99, 5.0, 6.0};
+const GaussDestrParameters benchGauss{100.0, 20.0};
+
+std::vector<double> grid(int dotsNum) {
+    return linspace(-(benchGauss.mean + 3 * benchGauss.sigma), benchGauss.mean + 3 * benchGauss.sigma,
+                    static_cast<size_t>(dotsNum));
+}
+
+// dd.mm.yyyy of a day counted from 1970-01-01.
+std::string formatDate(long long days) {
+    days += 719468;
+    const long long era = (days >= 0 ? days : days - 146096) / 146097;
+    const long long doe = days - era * 146097;
+    const long long yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const long long doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const long long mp = (5 * doy + 2) / 153;
+    const long long day = doy - (153 * mp + 2) / 5 + 1;
+    const long long month = mp < 10 ? mp + 3 : mp - 9;
+    const long long year = yoe + era * 400 + (month <= 2);
+    char buf[64];
+    std::snprintf(buf, sizeof(buf), "%02lld.%02lld.%04lld", day, month, year);
+    return buf;
+}
+
+// Ten years of daily history; large files get several rows (receipts) per day.
+void writeSalesFile(const std::string &filename, long long rows) {
+    std::FILE *file = std::fopen(filename.c_str(), "w");
+    if (!file) {
+        return;
+    }
+    std::fprintf(file, "Purchase Forecast file\n");
+    std::mt19937_64 rng(42);
+    std::normal_distribution<double> sales(80.0, 15.0);
+    const long long rowsPerDay = std::max(1LL, rows / 3650);
+    const long long firstDay = 17897;  // 01.01.2019
+    for (long long i = 0; i < rows; ++i) {
+        std::fprintf(file, "%s\t%.2f\n", formatDate(firstDay + i / rowsPerDay).c_str(), std::max(0.0, sales(rng)));
+    }
+    std::fclose(file);
+}
+
+void writeJson(std::FILE *out, const std::vector<Measurement> &results) {
+    std::fprintf(out, "{\n  \"benchmark\": \"PurchaseForecastBench\",\n  \"version\": 1,\n  \"results\": [\n");
+    for (size_t i = 0; i < results.size(); ++i) {
+        const auto &res = results[i];
+        std::fprintf(out, "    {\"name\": \"%s\"", res.name.c_str());
+        for (const auto &[key, value]: res.params) {
+            std::fprintf(out, ", \"%s\": %lld", key.c_str(), value);
+        }
+        std::fprintf(out, ", \"iterations\": %lld, \"seconds\": %.9g, \"seconds_per_iteration\": %.9g}%s\n",
+                     res.iterations, res.seconds, res.seconds / static_cast<double>(res.iterations),
+                     i + 1 < results.size() ? "," : "");
+    }
+    std::fprintf(out, "  ]\n}\n");
+}
+
+}
+
+int main(int argc, char *argv[]) {
+    std::map<std::string, std::string> options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.rfind("--", 0) != 0 || i + 1 >= argc) {
+            std::fprintf(stderr, "%s", usage);
+            return arg == "-h" || arg == "--help" ? 0 : 1;
+        }
+        options[arg.substr(2)] = argv[++i];
+    }
+    auto option = [&options](const std::string &key, double fallback) {
+        auto it = options.find(key);
+        return it == options.end() ? fallback : std::atof(it->second.c_str());
+    };
+    const int minResolution = static_cast<int>(option("min-resolution", 10));
+    const int maxResolution = static_cast<int>(option("max-resolution", 22));
+    const int maxPeriods = static_cast<int>(option("max-periods", 365));
+    const long long maxRows = static_cast<long long>(option("max-rows", 1e7));
+    const long long maxPolicies = static_cast<long long>(option("max-policies", 1e4));
+    const double minTime = option("min-time", 0.2);
+    const unsigned threads = static_cast<unsigned>(std::max(option("threads", 1), 1.0));
+    std::vector<unsigned> teams{1};
+    if (threads > 1) {
+        teams.push_back(threads);
+    }
+
+    std::vector<Measurement> results;
+
+    for (int res = minResolution; res <= maxResolution; ++res) {
+        const int dotsNum = 1 << res;
+        const auto x = grid(dotsNum);
+        const std::vector<double> source(x.size(), 1.0);
+        GaussConvolution convolution(benchGauss.mean, benchGauss.sigma, x);
+        convolution.setMethod(ConvolutionMethod::fft);
+        results.push_back(measure("convolution", {{"dots", dotsNum}}, [&] {
+            auto result = convolution.calculate(source);
+            (void) result;
+        }, minTime));
+        // Narrow kernels, to place the direct/FFT switch: taps = 16 * sigma / step.
+        for (long long taps = 16; taps <= 1024 && taps < dotsNum / 2; taps *= 4) {
+            const double step = x[1] - x[0];
+            convolution.setDistributionParams({benchGauss.mean, static_cast<double>(taps) * step / 16.0});
+            convolution.setMethod(ConvolutionMethod::direct);
+            results.push_back(measure("convolution_direct", {{"dots", dotsNum}, {"taps", taps}}, [&] {
+                auto result = convolution.calculate(source);
+                (void) result;
+            }, minTime));
+        }
+        convolution.setDistributionParams(benchGauss);
+
+        ExplicitIntegrator integrator(benchParams, benchGauss);
+        std::vector<double> out(x.size() / 2);
+        results.push_back(measure("integrator", {{"dots", dotsNum}}, [&] {
+            integrator.calculate(&x[x.size() / 2], out.data(), out.size());
+        }, minTime));
+        results.push_back(measure("integrator_scalar", {{"dots", dotsNum}}, [&] {
+            for (size_t i = 0; i < out.size(); ++i) {
+                out[i] = integrator.calculate(x[x.size() / 2 + i]);
+            }
+        }, minTime));
+    }
+
+    // The last period only initialises F, so a horizon of P periods runs P - 1 steps.
+    for (int res = minResolution; res <= maxResolution; res += 2) {
+        for (int periods: {2, 7, 30, 90, 365}) {
+            if (periods > maxPeriods) {
+                break;
+            }
+            for (unsigned team: teams) {
+                results.push_back(measure("solve", {{"dots", 1 << res}, {"periods", periods}, {"threads", team}}, [&] {
+                    TaskCalculator calculator(benchParams, benchGauss, periods,
+                                              std::make_shared<FftWorkspace>(1 << res, PlanRigor::estimate,
+                                                                             FftMode::real, team),
+                                              ValueStorage::rolling);
+                    calculator.setThreads(team);
+                    while (calculator.calcPeriod()) {
+                    }
+                    auto answer = calculator.getAnswer(0.0);
+                    (void) answer;
+                }, 0.0));
+            }
+        }
+    }
+
+#ifdef PURCHASE_FORECAST_FLOAT
+    // The same solves in the reduced precisions, serial.
+    auto solveIn = [](auto &calculator) {
+        while (calculator.calcPeriod()) {
+        }
+        auto answer = calculator.getAnswer(0.0);
+        (void) answer;
+    };
+    for (int res = minResolution; res <= maxResolution; res += 2) {
+        for (int periods: {2, 7, 30, 90, 365}) {
+            if (periods > maxPeriods) {
+                break;
+            }
+            results.push_back(measure("solve_mixed", {{"dots", 1 << res}, {"periods", periods}}, [&] {
+                MixedTaskCalculator calculator(benchParams, benchGauss, periods, 1 << res, PlanRigor::estimate,
+                                               FftMode::real, ValueStorage::rolling);
+                solveIn(calculator);
+            }, 0.0));
+            results.push_back(measure("solve_single", {{"dots", 1 << res}, {"periods", periods}}, [&] {
+                SingleTaskCalculator calculator(benchParams, benchGauss, periods, 1 << res, PlanRigor::estimate,
+                                                FftMode::real, ValueStorage::rolling);
+                solveIn(calculator);
+            }, 0.0));
+        }
+    }
+#endif
+
+    const auto dir = std::filesystem::temp_directory_path();
+    for (long long rows = 1000; rows <= maxRows; rows *= 10) {
+        const std::string filename = (dir / ("purchase_forecast_bench_" + std::to_string(rows) + ".txt")).string();
+        writeSalesFile(filename, rows);
+        std::vector<std::pair<time_t, double>> raw;
+        results.push_back(measure("read_file", {{"rows", rows}}, [&] {
+            raw = readFile(filename);
+        }, minTime));
+        for (Period period: {Period::day, Period::week, Period::month}) {
+            results.push_back(measure("parse_periods", {{"rows", rows}, {"period", static_cast<long long>(period)}}, [&] {
+                auto periods = parsePeriods(raw, period);
+                (void) periods;
+            }, minTime));
+        }
+        results.push_back(measure("read_periods", {{"rows", rows}}, [&] {
+            auto periods = parsePeriods(filename, Period::week);
+            (void) periods;
+        }, minTime));
+        std::filesystem::remove(filename);
+    }
+
+    // One 2^10-point, 30-period policy under many SKUs; snapshot_lookup times 1000 lookups at random
+    // SKUs, periods and stocks.
+    TaskCalculator policyCalculator(benchParams, benchGauss, 30, 1 << 10);
+    while (policyCalculator.calcPeriod()) {
+    }
+    PolicySnapshot policy = makeSnapshot(policyCalculator, "", benchParams);
+    for (long long count = 100; count <= maxPolicies; count *= 10) {
+        const std::string filename = (dir / ("purchase_forecast_bench_" + std::to_string(count) + ".policy")).string();
+        std::vector<PolicySnapshot> policies(static_cast<size_t>(count), policy);
+        for (long long k = 0; k < count; ++k) {
+            policies[k].sku = "SKU" + std::to_string(k);
+        }
+        writePolicySnapshots(filename, policies);
+        results.push_back(measure("snapshot_load", {{"policies", count}}, [&] {
+            PolicyStore store(filename);
+            (void) store;
+        }, minTime));
+        PolicyStore store(filename);
+        std::mt19937_64 random(0);
+        double sum = 0.0;
+        results.push_back(measure("snapshot_lookup", {{"policies", count}}, [&] {
+            for (int i = 0; i < 1000; ++i) {
+                const auto view = store.find(policies[random() % count].sku);
+                sum += view.order(random() % view.periods(), static_cast<double>(random() % 200)).value_or(0.0);
+            }
+        }, minTime));
+        (void) sum;
+        std::filesystem::remove(filename);
+    }
+
+    if (options["output"].empty()) {
+        writeJson(stdout, results);
+    } else {
+        std::FILE *out = std::fopen(options["output"].c_str(), "w");
+        if (!out) {
+            std::fprintf(stderr, "Can't write %s\n", options["output"].c_str());
+            return 1;
+        }
+        writeJson(out, results);
+        std::fclose(out);
+    }
+    return 0;
+}
@@ -0,0 +1,460 @@
+#include "batch.h"
+#include "period_aggregator.h"
+#include "sales_reader.h"
+#include "simulation.h"
+#include "solve_cache.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <string>
+
+namespace {
+
+const char *usage =
+        "Usage: PurchaseForecastCli [--config FILE] [--key value ...]\n"
+        "\n"
+        "Keys (also accepted as 'key = value' lines in the config file):\n"
+        "  periods_num          number of periods (default 1)\n"
+        "  period_type          day | week | month (default day)\n"
+        "  mean, sigma          demand distribution of a period\n"
+        "  purchasePrice        c\n"
+        "  profitOfOnePurchase  r\n"
+        "  storageCosts         h\n"
+        "  deficitCoefficient   p\n"
+        "  inflation            inflation per period, percent\n"
+        "  cur_stock            stock at the start of the first period\n"
+        "  cur_stocks           comma-separated stocks answered from the same solve\n"
+        "  resolution           grid size is 2^resolution (default 10); with a tolerance,\n"
+        "                       the smallest grid tried\n"
+        "  tolerance_goods      refine the grid until y_max and the answered order-up-to\n"
+        "                       levels change by at most this much\n"
+        "  tolerance_money      ... and the period and answered profits by at most this much\n"
+        "  max_resolution       largest grid tried with a tolerance, 2^max_resolution (default 20)\n"
+        "  history              Purchase Forecast file with sales history\n"
+        "  plan                 estimate | measure | patient (default estimate)\n"
+        "  fft                  real | complex (default real)\n"
+        "  precision            full | mixed | single (default full): float value functions and\n"
+        "                       transforms, the objective in double with mixed; halves their memory\n"
+        "                       (needs a build with PURCHASE_FORECAST_FLOAT)\n"
+        "  distribution         gauss | lognormal | negbinomial | empirical (default gauss);\n"
+        "                       empirical takes the shape of the history's period totals\n"
+        "  wisdom               FFTW wisdom file to load and update\n"
+        "  simulate             replay the policy in this many Monte Carlo scenarios\n"
+        "                       (and over the history, if given)\n"
+        "  seed                 random seed of the scenarios (default 0)\n"
+        "  converge             stop once y_max moves by at most this many goods between\n"
+        "                       periods and the value function by a constant up to\n"
+        "                       converge * purchasePrice, and extrapolate the rest\n"
+        "                       (only where the remaining periods share one distribution)\n"
+        "  solve_threads        threads inside one solve, for large grids (default 1)\n"
+        "  snapshot             write the solved policy as a binary snapshot to this file\n"
+        "                       (see policy_snapshot.h; in batch mode, every product's)\n"
+        "  snapshot_values      1 to store the first-period value function as well\n"
+        "  sku                  name of the product in the snapshot\n"
+        "  cache                directory of cached results; identical solves are read from it\n"
+        "  cache_memory         in-memory cache limit, MB (default 64)\n"
+        "  cache_disk           on-disk cache limit, MB (default 1024)\n"
+        "  stats                write per-stage solve timings as JSON to this file\n"
+        "                       (needs a build with PURCHASE_FORECAST_INSTRUMENTATION)\n"
+        "\n"
+        "Batch mode:\n"
+        "  catalogue            catalogue file, one product per line (see batch.h)\n"
+        "  output               results table, stdout by default\n"
+        "  threads              worker threads (default: all cores)\n"
+        "\n"
+        "Sweep mode, every combination of the listed values solved together:\n"
+        "  sweep_purchasePrice, sweep_profitOfOnePurchase, sweep_storageCosts,\n"
+        "  sweep_deficitCoefficient, sweep_inflation\n"
+        "                       comma-separated values replacing the single key\n"
+        "                       (threads spread the scenarios over cores, default 1)\n";
+
+bool readConfig(const std::string &filename, std::map<std::string, std::string> &options) {
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        return false;
+    }
+    std::string line;
+    while (getline(file, line)) {
+        auto comment = line.find('#');
+        if (comment != std::string::npos) {
+            line.erase(comment);
+        }
+        auto eq = line.find('=');
+        if (eq == std::string::npos) {
+            continue;
+        }
+        std::string key, value;
+        std::istringstream(line.substr(0, eq)) >> key;
+        std::istringstream(line.substr(eq + 1)) >> value;
+        if (!key.empty()) {
+            options[key] = value;
+        }
+    }
+    return true;
+}
+
+bool toDouble(const std::map<std::string, std::string> &options, const std::string &key, double &value) {
+    auto it = options.find(key);
+    if (it == options.end()) {
+        return true;
+    }
+    char *end = nullptr;
+    value = std::strtod(it->second.c_str(), &end);
+    if (end == it->second.c_str() || *end != '\0') {
+        std::cerr << "Bad value for " << key << ": " << it->second << "\n";
+        return false;
+    }
+    return true;
+}
+
+bool toInt(const std::map<std::string, std::string> &options, const std::string &key, int &value) {
+    double res = value;
+    if (!toDouble(options, key, res)) {
+        return false;
+    }
+    value = static_cast<int>(res);
+    return true;
+}
+
+// Comma-separated values of key, left untouched when the key is absent.
+bool toList(const std::map<std::string, std::string> &options, const std::string &key, std::vector<double> &values) {
+    auto it = options.find(key);
+    if (it == options.end()) {
+        return true;
+    }
+    values.clear();
+    std::istringstream input(it->second);
+    for (std::string item; getline(input, item, ',');) {
+        char *end = nullptr;
+        values.push_back(std::strtod(item.c_str(), &end));
+        if (end == item.c_str() || *end != '\0') {
+            std::cerr << "Bad value for " << key << ": " << item << "\n";
+            return false;
+        }
+    }
+    return !values.empty();
+}
+
+}
+
+int main(int argc, char *argv[]) {
+    std::map<std::string, std::string> options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help") {
+            std::cout << usage;
+            return 0;
+        }
+        if (arg.rfind("--", 0) != 0 || i + 1 >= argc) {
+            std::cerr << usage;
+            return 1;
+        }
+        std::string key = arg.substr(2);
+        std::string value = argv[++i];
+        if (key == "config") {
+            if (!readConfig(value, options)) {
+                std::cerr << "Can't open config file " << value << "\n";
+                return 1;
+            }
+        } else {
+            options[key] = value;
+        }
+    }
+
+    TaskParameters params{};
+    GaussDestrParameters gaussDestr{};
+    int periodsNum = 1;
+    int resolution = 10;
+    double inflation = 0.0;
+    double cur_x = 0.0;
+    if (!(toInt(options, "periods_num", periodsNum) && toInt(options, "resolution", resolution)
+          && toDouble(options, "mean", gaussDestr.mean) && toDouble(options, "sigma", gaussDestr.sigma)
+          && toDouble(options, "purchasePrice", params.purchasePrice)
+          && toDouble(options, "profitOfOnePurchase", params.profitOfOnePurchase)
+          && toDouble(options, "storageCosts", params.storageCosts)
+          && toDouble(options, "deficitCoefficient", params.deficitCoefficient)
+          && toDouble(options, "inflation", inflation) && toDouble(options, "cur_stock", cur_x))) {
+        return 1;
+    }
+    params.inflation = 1.0 - inflation / 100.0;
+    if (periodsNum < 1 || resolution < 2 || resolution > 30) {
+        std::cerr << "periods_num must be positive and resolution within [2, 30]\n";
+        return 1;
+    }
+
+    Period period = Period::day;
+    if (options["period_type"] == "week") {
+        period = Period::week;
+    } else if (options["period_type"] == "month") {
+        period = Period::month;
+    }
+    PlanRigor rigor = PlanRigor::estimate;
+    if (options["plan"] == "measure") {
+        rigor = PlanRigor::measure;
+    } else if (options["plan"] == "patient") {
+        rigor = PlanRigor::patient;
+    }
+    FftMode fftMode = options["fft"] == "complex" ? FftMode::complex : FftMode::real;
+    Distribution distribution = Distribution::gauss;
+    if (options["distribution"] == "lognormal") {
+        distribution = Distribution::lognormal;
+    } else if (options["distribution"] == "negbinomial") {
+        distribution = Distribution::negativeBinomial;
+    } else if (options["distribution"] == "empirical") {
+        distribution = Distribution::empirical;
+    }
+
+    int threads = 0;
+    double scenarios = 0.0;
+    double seed = 0.0;
+    double converge = 0.0;
+    int maxResolution = 20;
+    int solveThreads = 1;
+    SolveOptions solveOptions;
+    if (!(toInt(options, "threads", threads) && toDouble(options, "simulate", scenarios)
+          && toDouble(options, "seed", seed) && toDouble(options, "converge", converge)
+          && toDouble(options, "tolerance_goods", solveOptions.grid.goods)
+          && toDouble(options, "tolerance_money", solveOptions.grid.money)
+          && toInt(options, "max_resolution", maxResolution) && toInt(options, "solve_threads", solveThreads))) {
+        return 1;
+    }
+    if (options["precision"] == "mixed") {
+        solveOptions.precision = Precision::mixed;
+    } else if (options["precision"] == "single") {
+        solveOptions.precision = Precision::single;
+    }
+#ifndef PURCHASE_FORECAST_FLOAT
+    if (solveOptions.precision != Precision::full) {
+        std::cerr << "precision " << options["precision"] << " needs a build with PURCHASE_FORECAST_FLOAT\n";
+        return 1;
+    }
+#endif
+    solveOptions.convergence = std::max(converge, 0.0);
+    solveOptions.threads = static_cast<unsigned>(std::max(solveThreads, 1));
+    solveOptions.grid.minDots = 1 << resolution;
+    solveOptions.grid.maxDots = 1 << std::clamp(maxResolution, resolution, 30);
+    double cacheMemory = 64.0;
+    double cacheDisk = 1024.0;
+    if (!(toDouble(options, "cache_memory", cacheMemory) && toDouble(options, "cache_disk", cacheDisk))) {
+        return 1;
+    }
+    std::unique_ptr<SolveCache> cache;
+    if (!options["cache"].empty()) {
+        cache = std::make_unique<SolveCache>(static_cast<size_t>(std::max(cacheMemory, 0.0) * (1 << 20)),
+                                             options["cache"], static_cast<size_t>(std::max(cacheDisk, 0.0) * (1 << 20)));
+        solveOptions.cache = cache.get();
+    }
+    auto reportCache = [&cache] {
+        if (cache) {
+            writeCacheStats(std::cerr, cache->getStats());
+        }
+    };
+    const std::string snapshot = options["snapshot"];
+    solveOptions.keepPolicy = !snapshot.empty();
+    solveOptions.keepValueFunction = options["snapshot_values"] == "1";
+    auto writeSnapshot = [&snapshot](const std::vector<ProductResult> &results) {
+        std::vector<PolicySnapshot> policies;
+        for (const auto &it: results) {
+            if (it.policy) {
+                policies.push_back(*it.policy);
+            }
+        }
+        if (!writePolicySnapshots(snapshot, policies)) {
+            std::cerr << "Can't write " << snapshot << "\n";
+            return false;
+        }
+        return true;
+    };
+
+    const std::string wisdom = options["wisdom"];
+    if (!wisdom.empty()) {
+        loadFftwWisdom(wisdom);
+    }
+
+    if (!options["catalogue"].empty()) {
+        auto products = readCatalogue(options["catalogue"], period);
+        if (products.empty()) {
+            std::cerr << "Catalogue wasn't correct: " << options["catalogue"] << "\n";
+            return 1;
+        }
+        for (auto &product: products) {
+            product.distribution = distribution;
+        }
+        auto results = solveBatch(products, periodsNum, 1 << resolution, std::max(threads, 0), rigor, fftMode,
+                                  solveOptions);
+        if (!wisdom.empty()) {
+            saveFftwWisdom(wisdom);
+        }
+        if (!snapshot.empty() && !writeSnapshot(results)) {
+            return 1;
+        }
+        reportCache();
+        if (options["output"].empty()) {
+            writeResults(std::cout, results);
+        } else {
+            std::ofstream out(options["output"]);
+            if (!out.is_open()) {
+                std::cerr << "Can't write " << options["output"] << "\n";
+                return 1;
+            }
+            writeResults(out, results);
+        }
+        return 0;
+    }
+
+    Product product{options["sku"], params, gaussDestr, {}, cur_x, {}, distribution};
+    if (!options["history"].empty()) {
+        std::vector<MalformedLine> errors;
+        PeriodAggregator aggregator(period);
+        auto rows = readSalesFile(options["history"], [&aggregator](time_t date, double y) {
+            aggregator.add(date, y);
+        }, &errors);
+        for (const auto &error: errors) {
+            std::cerr << options["history"] << ":" << error.line << ": malformed line skipped: " << error.text << "\n";
+        }
+        if (rows == 0) {
+            std::cerr << "File wasn't correct: " << options["history"] << "\n";
+            return 1;
+        }
+        product.gaussVec = aggregator.periods();
+    }
+    const auto history = product.gaussVec;
+    std::istringstream stocks(options["cur_stocks"]);
+    for (std::string stock; getline(stocks, stock, ',');) {
+        char *end = nullptr;
+        product.stockLevels.push_back(std::strtod(stock.c_str(), &end));
+        if (end == stock.c_str()) {
+            std::cerr << "Bad value for cur_stocks: " << stock << "\n";
+            return 1;
+        }
+    }
+    const bool sweep = options.count("sweep_purchasePrice") || options.count("sweep_profitOfOnePurchase")
+                       || options.count("sweep_storageCosts") || options.count("sweep_deficitCoefficient")
+                       || options.count("sweep_inflation");
+    if (sweep) {
+        std::vector<double> c{params.purchasePrice}, r{params.profitOfOnePurchase}, h{params.storageCosts},
+                p{params.deficitCoefficient}, inflations{inflation};
+        if (!(toList(options, "sweep_purchasePrice", c) && toList(options, "sweep_profitOfOnePurchase", r)
+              && toList(options, "sweep_storageCosts", h) && toList(options, "sweep_deficitCoefficient", p)
+              && toList(options, "sweep_inflation", inflations))) {
+            return 1;
+        }
+        std::vector<TaskParameters> scenarioParams;
+        std::vector<double> scenarioInflation;
+        for (double ci: c) {
+            for (double ri: r) {
+                for (double hi: h) {
+                    for (double pi: p) {
+                        for (double inflationI: inflations) {
+                            scenarioParams.push_back({ri, hi, 1.0 - inflationI / 100.0, pi, ci});
+                            scenarioInflation.push_back(inflationI);
+                        }
+                    }
+                }
+            }
+        }
+        solveOptions.threads = static_cast<unsigned>(std::max(threads, 1));
+        auto results = sweepProduct(product, scenarioParams, periodsNum, 1 << resolution, rigor, fftMode,
+                                    solveOptions);
+        if (!wisdom.empty()) {
+            saveFftwWisdom(wisdom);
+        }
+        std::cout << "scenario\tpurchasePrice\tprofitOfOnePurchase\tstorageCosts\tdeficitCoefficient\tinflation"
+                     "\torder\tperiod_profit\ttotal_profit\n";
+        for (size_t k = 0; k < results.size(); ++k) {
+            const auto &it = scenarioParams[k];
+            std::cout << k << "\t" << it.purchasePrice << "\t" << it.profitOfOnePurchase << "\t" << it.storageCosts
+                      << "\t" << it.deficitCoefficient << "\t" << scenarioInflation[k] << "\t";
+            if (!results[k].answer) {
+                std::cout << "\t\t\n";
+                continue;
+            }
+            std::cout << results[k].order << "\t" << results[k].answer->thisPeriodProfit << "\t"
+                      << results[k].answer->MaxProfit << "\n";
+        }
+        std::cout << "scenario\tperiod\ty_max\tprofit_max\n";
+        for (size_t k = 0; k < results.size(); ++k) {
+            for (size_t i = 0; i < results[k].y_max.size(); ++i) {
+                std::cout << k << "\t" << i + 2 << "\t" << results[k].y_max[i] << "\t" << results[k].profit_max[i]
+                          << "\n";
+            }
+        }
+        return 0;
+    }
+
+    auto workspace = std::make_shared<FftWorkspace>(1 << resolution, rigor, fftMode, solveOptions.threads);
+    auto result = solveProduct(product, periodsNum, std::move(workspace), solveOptions);
+    if (!wisdom.empty()) {
+        saveFftwWisdom(wisdom);
+    }
+    if (!result.answer) {
+        std::cerr << "No solution: sigma must be positive and cur_stock must lie within the grid"
+                  << (distribution == Distribution::empirical ? ", and the empirical distribution needs a history" : "")
+                  << "\n";
+        return 1;
+    }
+    reportCache();
+    if (!snapshot.empty() && !writeSnapshot({result})) {
+        return 1;
+    }
+    if (!options["stats"].empty()) {
+        std::ofstream out(options["stats"]);
+        if (!out.is_open()) {
+            std::cerr << "Can't write " << options["stats"] << "\n";
+            return 1;
+        }
+        writeStatsJson(out, result.stats);
+    }
+    std::cout << "order\t" << result.order << "\n";
+    std::cout << "period_profit\t" << result.answer->thisPeriodProfit << "\n";
+    std::cout << "total_profit\t" << result.answer->MaxProfit << "\n";
+    if (solveOptions.grid.enabled()) {
+        std::cout << "dots_num\t" << result.grid.dotsNum << "\n";
+        std::cout << "grid_error_goods\t" << result.grid.goodsError << "\n";
+        std::cout << "grid_error_money\t" << result.grid.moneyError << "\n";
+        if (!result.grid.met) {
+            std::cerr << "Tolerance not met on the largest grid, 2^" << std::clamp(maxResolution, resolution, 30)
+                      << " points\n";
+        }
+    }
+    if (result.stationaryPeriod >= 0) {
+        std::cout << "stationary_period\t" << result.stationaryPeriod + 2 << "\n";
+    }
+
+    std::cout << "period\ty_max\tprofit_max\n";
+    for (size_t i = 0; i < result.y_max.size(); ++i) {
+        std::cout << i + 2 << "\t" << result.y_max[i] << "\t" << result.profit_max[i] << "\n";
+    }
+    if (!product.stockLevels.empty()) {
+        std::cout << "stock\torder\tperiod_profit\ttotal_profit\n";
+        for (size_t i = 0; i < product.stockLevels.size(); ++i) {
+            const double stock = product.stockLevels[i];
+            const auto &ans = result.stockAnswers[i];
+            if (!ans) {
+                std::cout << stock << "\t\t\t\n";
+                continue;
+            }
+            double order = ans->y - stock;
+            std::cout << stock << "\t" << (order < 0.01 ? 0.0 : order) << "\t" << ans->thisPeriodProfit << "\t"
+                      << ans->MaxProfit << "\n";
+        }
+    }
+    if (scenarios > 0) {
+        auto policy = makePolicy(*result.answer, result.y_max, gridDistribution(gaussDestr, product.gaussVec),
+                                 product.gaussVec);
+        std::cout << "simulation\tgauss\n";
+        writeSummary(std::cout, simulateGaussian(policy, params, cur_x, static_cast<uint64_t>(scenarios),
+                                                 static_cast<uint64_t>(seed), std::max(threads, 0)));
+        if (!history.empty()) {
+            std::vector<double> demand;
+            for (const auto &it: history) {
+                demand.push_back(it.mean);
+            }
+            std::cout << "simulation\thistory\n";
+            writeSummary(std::cout, simulateHistory(policy, params, cur_x, demand, std::max(threads, 0)));
+        }
+    }
+    return 0;
+}
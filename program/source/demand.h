@@ -0,0 +1,270 @@
+#pragma once
+
+#include "models.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#define _USE_MATH_DEFINES
+#include <math.h>
+
+// Demand distribution policies for the solver templates (DemandConvolution, DemandIntegrator,
+// BasicTaskCalculator). Every policy is parameterised per period by the mean and standard
+// deviation of demand (GaussDestrParameters) and supplies
+//   setParams(GaussDestrParameters)
+//   mean()                          E[D]
+//   expectedLeftover(y)             E[(y - D)^+], the only moment the expected profit needs
+//   kernel(d, step, firstCell)      weight of the convolution kernel at grid point d, a density:
+//                                   the mass of the cell of width step around d divided by step
+//                                   (firstCell: the cell also takes all mass below it)
+// The calls are resolved at compile time, so a policy costs only its own arithmetic.
+
+// Normal distribution truncated at zero, the model the solver was built on.
+class GaussianDemand {
+public:
+    void setParams(GaussDestrParameters params) {
+        M = params.mean;
+        s = params.sigma;
+        erfPermanent = std::erf(M / (std::sqrt(2.0) * s)) / 2.0;
+        expPermanent = std::exp(-M * M / (2.0 * s * s)) * (s / Sqrt2Pi);
+        densityCoefficient = 0.5 + erfPermanent;
+        ConstantInExp = -1.0 / (2.0 * s * s);
+    }
+
+    double mean() const {
+        return (expPermanent + M / 2.0 + M * erfPermanent) / densityCoefficient;
+    }
+
+    double expectedLeftover(double y) const {
+        if (y <= 0.0) {
+            return 0.0;
+        }
+        double erfCurrent = std::erf((M - y) / (std::sqrt(2) * s)) / 2.0;
+        double expCurrent = std::exp(-(M - y) * (M - y) / (2.0 * s * s)) * (s / Sqrt2Pi);
+        double probFromZeroToY = (erfPermanent - erfCurrent) / densityCoefficient;
+        double momentFromZeroToY = (M * (erfPermanent - erfCurrent) + expPermanent - expCurrent) / densityCoefficient;
+        return y * probFromZeroToY - momentFromZeroToY;
+    }
+
+    // Point density of the untruncated normal, as the kernel has always been.
+    double kernel(double d, double, bool) const {
+        return std::exp(ConstantInExp * (M - d) * (M - d)) / (s * Sqrt2Pi);
+    }
+
+private:
+    double M = 0.0;
+    double s = 1.0;
+    double erfPermanent = 0.0;
+    double expPermanent = 0.0;
+    double densityCoefficient = 1.0;
+    double ConstantInExp = -0.5;
+    const double Sqrt2Pi = std::sqrt(2.0 * M_PI);
+};
+
+// Lognormal with the given mean and standard deviation; right-skewed, no mass below zero.
+class LognormalDemand {
+public:
+    void setParams(GaussDestrParameters params) {
+        M = std::max(params.mean, std::numeric_limits<double>::min());
+        sigmaLog = std::sqrt(std::log1p(params.sigma * params.sigma / (M * M)));
+        muLog = std::log(M) - sigmaLog * sigmaLog / 2.0;
+    }
+
+    double mean() const {
+        return M;
+    }
+
+    double expectedLeftover(double y) const {
+        if (y <= 0.0) {
+            return 0.0;
+        }
+        const double a = (std::log(y) - muLog) / sigmaLog;
+        return y * phi(a) - M * phi(a - sigmaLog);
+    }
+
+    double kernel(double d, double step, bool firstCell) const {
+        return (cdf(d + step / 2.0) - (firstCell ? 0.0 : cdf(d - step / 2.0))) / step;
+    }
+
+private:
+    static double phi(double t) {
+        return 0.5 * std::erfc(-t / std::sqrt(2.0));
+    }
+
+    double cdf(double t) const {
+        return t <= 0.0 ? 0.0 : phi((std::log(t) - muLog) / sigmaLog);
+    }
+
+private:
+    double M = 1.0;
+    double muLog = 0.0;
+    double sigmaLog = 1.0;
+};
+
+// Negative binomial with the given mean and variance sigma^2; Poisson when sigma^2 <= mean.
+// P(D <= k) and E[D; D <= k] are tabulated as prefix sums when the parameters change. The tables
+// only grow: a period reallocates them only when it needs more entries than any before.
+class NegativeBinomialDemand {
+public:
+    void setParams(GaussDestrParameters params) {
+        const double m = std::max(params.mean, 0.0);
+        const double var = params.sigma * params.sigma;
+        const size_t size = static_cast<size_t>(std::ceil(m + 12.0 * std::sqrt(std::max(var, m)) + 12.0));
+        prob.resize(size);
+        moment.resize(size);
+        double cumProb = 0.0;
+        double cumMoment = 0.0;
+        const bool poisson = var <= m;
+        const double r = poisson ? 0.0 : m * m / (var - m);
+        const double logQ = poisson ? 0.0 : std::log(m / (r + m));
+        const double rLogP = poisson ? 0.0 : r * std::log(r / (r + m));
+        for (size_t k = 0; k < size; ++k) {
+            const double kk = static_cast<double>(k);
+            double pmf;
+            if (m == 0.0) {
+                pmf = k == 0 ? 1.0 : 0.0;
+            } else if (poisson) {
+                pmf = std::exp(kk * std::log(m) - m - std::lgamma(kk + 1.0));
+            } else {
+                pmf = std::exp(std::lgamma(kk + r) - std::lgamma(r) - std::lgamma(kk + 1.0) + rLogP + kk * logQ);
+            }
+            cumProb += pmf;
+            cumMoment += kk * pmf;
+            prob[k] = cumProb;
+            moment[k] = cumMoment;
+        }
+    }
+
+    double mean() const {
+        return moment.empty() ? 0.0 : moment.back();
+    }
+
+    double expectedLeftover(double y) const {
+        if (y < 0.0 || prob.empty()) {
+            return 0.0;
+        }
+        const size_t k = std::min(static_cast<size_t>(y), prob.size() - 1);
+        return y * prob[k] - moment[k];
+    }
+
+    double kernel(double d, double step, bool firstCell) const {
+        return (cdf(d + step / 2.0) - (firstCell ? 0.0 : cdf(d - step / 2.0))) / step;
+    }
+
+private:
+    double cdf(double t) const {
+        if (t < 0.0 || prob.empty()) {
+            return 0.0;
+        }
+        return prob[std::min(static_cast<size_t>(t), prob.size() - 1)];
+    }
+
+private:
+    std::vector<double> prob;
+    std::vector<double> moment;
+};
+
+// Standardised shape of an empirical distribution: sorted (d - mean) / sigma of the
+// observations, with prefix sums, shared by every period and copy of the policy.
+struct EmpiricalShape {
+    std::vector<double> z;
+    std::vector<double> prefix;     // prefix[k] = z[0] + ... + z[k - 1]
+};
+
+// Fewer than two distinct observations give a point mass at the mean.
+inline std::shared_ptr<const EmpiricalShape> makeEmpiricalShape(const std::vector<double> &observations) {
+    auto shape = std::make_shared<EmpiricalShape>();
+    double mean = 0.0;
+    double m2 = 0.0;
+    size_t count = 0;
+    for (double it: observations) {
+        ++count;
+        double delta = it - mean;
+        mean += delta / static_cast<double>(count);
+        m2 += delta * (it - mean);
+    }
+    const double sigma = count > 1 ? std::sqrt(m2 / static_cast<double>(count - 1)) : 0.0;
+    if (sigma > 0.0) {
+        for (double it: observations) {
+            shape->z.push_back((it - mean) / sigma);
+        }
+        std::sort(shape->z.begin(), shape->z.end());
+    } else {
+        shape->z.push_back(0.0);
+    }
+    shape->prefix.resize(shape->z.size() + 1, 0.0);
+    for (size_t i = 0; i < shape->z.size(); ++i) {
+        shape->prefix[i + 1] = shape->prefix[i] + shape->z[i];
+    }
+    return shape;
+}
+
+// Demand of a period is mean + sigma * Z, Z drawn from the observed shape, clamped at zero.
+class EmpiricalDemand {
+public:
+    explicit EmpiricalDemand(std::shared_ptr<const EmpiricalShape> shape_ = makeEmpiricalShape({}))
+            : shape(std::move(shape_)), n(static_cast<double>(shape->z.size())) {
+    }
+
+    void setParams(GaussDestrParameters params) {
+        M = params.mean;
+        s = std::max(params.sigma, 0.0);
+        const auto &z = shape->z;
+        // Observations with M + s * z < 0 sit at zero.
+        if (s > 0.0) {
+            first = std::lower_bound(z.begin(), z.end(), -M / s) - z.begin();
+        } else {
+            first = M < 0.0 ? z.size() : 0;
+        }
+        total = sumBelow(z.size());
+    }
+
+    double mean() const {
+        return total / n;
+    }
+
+    double expectedLeftover(double y) const {
+        if (y < 0.0) {
+            return 0.0;
+        }
+        const size_t k = countUpTo(y);
+        return (y * static_cast<double>(k) - sumBelow(k)) / n;
+    }
+
+    double kernel(double d, double step, bool firstCell) const {
+        const double lower = firstCell ? 0.0 : static_cast<double>(countUpTo(d - step / 2.0));
+        return (static_cast<double>(countUpTo(d + step / 2.0)) - lower) / (n * step);
+    }
+
+private:
+    // Number of observations whose demand is <= t.
+    size_t countUpTo(double t) const {
+        const auto &z = shape->z;
+        if (t < 0.0) {
+            return 0;
+        }
+        if (s == 0.0) {
+            return std::max(M, 0.0) <= t ? z.size() : 0;
+        }
+        return std::max(first, static_cast<size_t>(std::upper_bound(z.begin(), z.end(), (t - M) / s) - z.begin()));
+    }
+
+    // Demand summed over the k smallest observations.
+    double sumBelow(size_t k) const {
+        if (k <= first) {
+            return 0.0;
+        }
+        return M * static_cast<double>(k - first) + s * (shape->prefix[k] - shape->prefix[first]);
+    }
+
+private:
+    std::shared_ptr<const EmpiricalShape> shape;
+    double n;
+    double M = 0.0;
+    double s = 0.0;
+    size_t first = 0;
+    double total = 0.0;
+};
@@ -0,0 +1,185 @@
+#include "equations.h"
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__GNUC__) && defined(__x86_64__) && defined(__linux__)
+#define SIMD_CLONES __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+#define SIMD_CLONES
+#endif
+
+namespace {
+
+// Chebyshev coefficients of erfc on [0, inf), Numerical Recipes 3rd ed., 6.2.2.
+constexpr double erfcCoef[28] = {
+        -1.3026537197817094, 6.4196979235649026e-1, 1.9476473204185836e-2, -9.561514786808631e-3,
+        -9.46595344482036e-4, 3.66839497852761e-4, 4.2523324806907e-5, -2.0278578112534e-5,
+        -1.624290004647e-6, 1.303655835580e-6, 1.5626441722e-8, -8.5238095915e-8,
+        6.529054439e-9, 5.059343495e-9, -9.91364156e-10, -2.27365122e-10,
+        9.6467911e-11, 2.394038e-12, -6.886027e-12, 8.94487e-13,
+        3.13092e-13, -1.12708e-13, 3.81e-16, 7.106e-15,
+        -1.523e-15, -9.4e-17, 1.21e-16, -2.8e-17};
+
+// Branch-free exp: x = k ln2 + r, degree 13 Taylor polynomial on |r| <= ln2/2,
+// 2^k assembled in the exponent bits. Arguments are clamped to [-708, 709].
+inline double expKernel(double x) {
+    const double log2e = 1.4426950408889634;
+    const double ln2hi = 6.93147180369123816490e-01;
+    const double ln2lo = 1.90821492927058770002e-10;
+    const double shifter = 6755399441055744.0;  // 1.5 * 2^52, rounds to an integer in the low bits
+
+    double xc = std::min(std::max(x, -708.0), 709.0);
+    double kk = xc * log2e + shifter;
+    double k = kk - shifter;
+    double r = (xc - k * ln2hi) - k * ln2lo;
+    double p = 1.0 / 6227020800.0;
+    p = p * r + 1.0 / 479001600.0;
+    p = p * r + 1.0 / 39916800.0;
+    p = p * r + 1.0 / 3628800.0;
+    p = p * r + 1.0 / 362880.0;
+    p = p * r + 1.0 / 40320.0;
+    p = p * r + 1.0 / 5040.0;
+    p = p * r + 1.0 / 720.0;
+    p = p * r + 1.0 / 120.0;
+    p = p * r + 1.0 / 24.0;
+    p = p * r + 1.0 / 6.0;
+    p = p * r + 0.5;
+    p = p * r + 1.0;
+    p = p * r + 1.0;
+
+    int64_t bits;
+    std::memcpy(&bits, &kk, sizeof(bits));
+    bits = (bits - 0x4338000000000000LL + 1023) << 52;
+    double scale;
+    std::memcpy(&scale, &bits, sizeof(scale));
+    return p * scale;
+}
+
+// erfc(z) for z >= 0 by Clenshaw summation of the Chebyshev series.
+inline double erfcKernel(double z) {
+    double t = 2.0 / (2.0 + z);
+    double ty = 4.0 * t - 2.0;
+    double d = 0.0;
+    double dd = 0.0;
+#pragma GCC unroll 32
+    for (int j = 27; j > 0; --j) {
+        double tmp = d;
+        d = ty * d - dd + erfcCoef[j];
+        dd = tmp;
+    }
+    return t * expKernel(-z * z + 0.5 * (erfcCoef[0] + ty * d) - dd);
+}
+
+// Float versions: degree 7 on |r| <= ln2/2, arguments clamped to [-87, 88] so 2^k stays normal.
+inline float expKernel(float x) {
+    const float log2e = 1.44269504f;
+    const float ln2hi = 0.693359375f;
+    const float ln2lo = -2.12194440e-4f;
+    const float shifter = 12582912.0f;  // 1.5 * 2^23
+
+    float xc = std::min(std::max(x, -87.0f), 88.0f);
+    float kk = xc * log2e + shifter;
+    float k = kk - shifter;
+    float r = (xc - k * ln2hi) - k * ln2lo;
+    float p = 1.0f / 5040.0f;
+    p = p * r + 1.0f / 720.0f;
+    p = p * r + 1.0f / 120.0f;
+    p = p * r + 1.0f / 24.0f;
+    p = p * r + 1.0f / 6.0f;
+    p = p * r + 0.5f;
+    p = p * r + 1.0f;
+    p = p * r + 1.0f;
+
+    int32_t bits;
+    std::memcpy(&bits, &kk, sizeof(bits));
+    bits = (bits - 0x4B400000 + 127) << 23;
+    float scale;
+    std::memcpy(&scale, &bits, sizeof(scale));
+    return p * scale;
+}
+
+// The terms of erfcCoef past the 14th are below float resolution.
+inline float erfcKernel(float z) {
+    float t = 2.0f / (2.0f + z);
+    float ty = 4.0f * t - 2.0f;
+    float d = 0.0f;
+    float dd = 0.0f;
+#pragma GCC unroll 16
+    for (int j = 13; j > 0; --j) {
+        float tmp = d;
+        d = ty * d - dd + static_cast<float>(erfcCoef[j]);
+        dd = tmp;
+    }
+    return t * expKernel(-z * z + 0.5f * (static_cast<float>(erfcCoef[0]) + ty * d) - dd);
+}
+
+template<typename Real>
+inline void convolveBlocks(const Real *source, const Real *taps, size_t tapsNum, Real *out, size_t count,
+                           Real coef) {
+    // Blocks of the output stay in L1 while every tap is added to them.
+    constexpr size_t block = 512;
+    for (size_t begin = 0; begin < count; begin += block) {
+        const size_t end = std::min(count, begin + block);
+        for (size_t i = begin; i < end; ++i) {
+            out[i] = 0;
+        }
+        for (size_t t = 0; t < tapsNum; ++t) {
+            const Real tap = taps[t];
+            const Real *src = source + t;
+#pragma omp simd
+            for (size_t i = begin; i < end; ++i) {
+                out[i] += tap * src[i];
+            }
+        }
+        for (size_t i = begin; i < end; ++i) {
+            out[i] *= coef;
+        }
+    }
+}
+
+}
+
+SIMD_CLONES
+void expectedProfit(const ExpectedProfitConstants &c, const double *y, double *out, size_t count) {
+#pragma omp simd
+    for (size_t i = 0; i < count; ++i) {
+        double dev = c.M - y[i];
+        double z = dev * c.invSqrt2S;
+        double erfHalf = std::copysign(0.5 - 0.5 * erfcKernel(std::fabs(z)), z);
+        double expCurrent = expKernel(-z * z) * c.expScale;
+        out[i] = c.base + c.linear * y[i] + c.tail * (dev * (c.erfPermanent - erfHalf) + c.expPermanent - expCurrent);
+    }
+}
+
+SIMD_CLONES
+void expectedProfit(const ExpectedProfitConstants &c, const float *y, float *out, size_t count) {
+    const auto M = static_cast<float>(c.M);
+    const auto invSqrt2S = static_cast<float>(c.invSqrt2S);
+    const auto expScale = static_cast<float>(c.expScale);
+    const auto erfPermanent = static_cast<float>(c.erfPermanent);
+    const auto expPermanent = static_cast<float>(c.expPermanent);
+    const auto base = static_cast<float>(c.base);
+    const auto linear = static_cast<float>(c.linear);
+    const auto tail = static_cast<float>(c.tail);
+#pragma omp simd
+    for (size_t i = 0; i < count; ++i) {
+        float dev = M - y[i];
+        float z = dev * invSqrt2S;
+        float erfHalf = std::copysign(0.5f - 0.5f * erfcKernel(std::fabs(z)), z);
+        float expCurrent = expKernel(-z * z) * expScale;
+        out[i] = base + linear * y[i] + tail * (dev * (erfPermanent - erfHalf) + expPermanent - expCurrent);
+    }
+}
+
+SIMD_CLONES
+void directConvolution(const double *source, const double *taps, size_t tapsNum, double *out, size_t count,
+                       double coef) {
+    convolveBlocks(source, taps, tapsNum, out, count, coef);
+}
+
+SIMD_CLONES
+void directConvolution(const float *source, const float *taps, size_t tapsNum, float *out, size_t count,
+                       float coef) {
+    convolveBlocks(source, taps, tapsNum, out, count, coef);
+}
@@ -1,6 +1,9 @@
 #pragma once
 
 #include "models.h"
+#include "demand.h"
+#include "instrumentation.h"
+#include "thread_team.h"
 
 #include <fftw3.h>
 #include <complex>
@@ -9,11 +12,47 @@
 #include <numbers>
 #include <functional>
 #include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
 
 #define _USE_MATH_DEFINES
 #include <math.h>
 
-class ExplicitIntegrator : public Integrator {
+// Per-period constants of ExplicitIntegrator, hoisted out of the grid loop:
+// profit(y) = base + linear * y + tail * ((M - y) * (erfPermanent - erf(z) / 2) + expPermanent - expScale * exp(-z^2)),
+// z = (M - y) * invSqrt2S.
+struct ExpectedProfitConstants {
+    double M;
+    double invSqrt2S;
+    double expScale;
+    double erfPermanent;
+    double expPermanent;
+    double base;
+    double linear;
+    double tail;
+};
+
+// Evaluates the expression above for count points with vectorized erf/exp kernels
+// (AVX-512/AVX2 clones where the compiler supports them, scalar otherwise).
+// Agrees with the std::erf/std::exp evaluation to about 1e-15 relative to the erf/exp terms.
+void expectedProfit(const ExpectedProfitConstants &c, const double *y, double *out, size_t count);
+
+// out[i] = coef * sum over t < tapsNum of taps[t] * source[i + t], for i < count.
+void directConvolution(const double *source, const double *taps, size_t tapsNum, double *out, size_t count,
+                       double coef);
+
+// Single-precision kernels for Precision::single and mixed: the constants are rounded to float and
+// the erfc series and exp polynomial are shortened to float accuracy (about 1e-6 relative).
+void expectedProfit(const ExpectedProfitConstants &c, const float *y, float *out, size_t count);
+
+void directConvolution(const float *source, const float *taps, size_t tapsNum, float *out, size_t count,
+                       float coef);
+
+class ExplicitIntegrator final : public Integrator {
 
 public:
     ExplicitIntegrator(TaskParameters params, GaussDestrParameters gauss)
@@ -22,6 +61,10 @@ public:
         updateConstants();
     }
 
+    ExplicitIntegrator(TaskParameters params, GaussDestrParameters gauss, const GaussianDemand &)
+            : ExplicitIntegrator(params, gauss) {
+    }
+
     double calculate(double y) const override {
         double erfCurrent = std::erf((M - y) / (std::sqrt(2) * s)) / 2.0;
         double expCurrent = std::exp(-(M - y) * (M - y) / (2.0 * s * s)) * (s / Sqrt2Pi);
@@ -33,13 +76,32 @@ public:
                + (-alpha * r + p + r + h) * momentFromZeroToY + ((alpha - 1) * r - p - h) * y * probFromZeroToY;
     }
 
+    void calculate(const double *y, double *out, size_t count) const override {
+        SOLVE_STAGE(stats, Stage::integrator);
+        expectedProfit(constants(), y, out, count);
+    }
+
+    void calculate(const float *y, float *out, size_t count) const override {
+        SOLVE_STAGE(stats, Stage::integrator);
+        expectedProfit(constants(), y, out, count);
+    }
+
     void setDistributionParams(GaussDestrParameters params) {
         M = params.mean;
         s = params.sigma;
         updateConstants();
     }
 
+    void setStats(SolveStats *stats_) {
+        stats = stats_;
+    }
+
 private:
+    ExpectedProfitConstants constants() const {
+        return {M, 1.0 / (std::sqrt(2.0) * s), s / Sqrt2Pi, erfPermanent, expPermanent,
+                (alpha * r - p) * firstMoment, (1 - alpha) * r + p, (-alpha * r + p + r + h) / densityCoefficient};
+    }
+
     void updateConstants() {
         erfPermanent = std::erf(M / (std::sqrt(2.0) * s)) / 2.0;
         expPermanent = std::exp(-M * M / (2.0 * s * s)) * (s / Sqrt2Pi);
@@ -60,77 +122,646 @@ private:
     double densityCoefficient;
     double firstMoment;
     const double Sqrt2Pi = std::sqrt(2.0 * M_PI);
+    SolveStats *stats = nullptr;
+};
+
+// Expected profit of a period for any demand policy:
+// (alpha * r - p) * E[D] + ((1 - alpha) * r + p) * y - ((1 - alpha) * r + p + h) * E[(y - D)^+],
+// which is ExplicitIntegrator's expression with the truncated normal moments factored out.
+template<typename Demand>
+class DemandIntegrator final : public Integrator {
+public:
+    DemandIntegrator(TaskParameters params, GaussDestrParameters gauss, Demand demand_ = Demand{})
+            : r{params.profitOfOnePurchase}, h{params.storageCosts}, alpha{params.inflation},
+              p{params.deficitCoefficient}, demand(std::move(demand_)) {
+        setDistributionParams(gauss);
+    }
+
+    double calculate(double y) const override {
+        return base + linear * y - leftover * demand.expectedLeftover(y);
+    }
+
+    void calculate(const double *y, double *out, size_t count) const override {
+        SOLVE_STAGE(stats, Stage::integrator);
+        for (size_t i = 0; i < count; ++i) {
+            out[i] = base + linear * y[i] - leftover * demand.expectedLeftover(y[i]);
+        }
+    }
+
+    // The policies' moments are evaluated in double either way.
+    void calculate(const float *y, float *out, size_t count) const override {
+        SOLVE_STAGE(stats, Stage::integrator);
+        for (size_t i = 0; i < count; ++i) {
+            out[i] = static_cast<float>(calculate(static_cast<double>(y[i])));
+        }
+    }
+
+    void setDistributionParams(GaussDestrParameters params) {
+        demand.setParams(params);
+        base = (alpha * r - p) * demand.mean();
+    }
+
+    void setStats(SolveStats *stats_) {
+        stats = stats_;
+    }
+
+private:
+    double r;
+    double h;
+    double alpha;
+    double p;
+    double base = 0.0;
+    const double linear = (1 - alpha) * r + p;
+    const double leftover = (1 - alpha) * r + p + h;
+    Demand demand;
+    SolveStats *stats = nullptr;
 };
 
+// Integrator the solver uses with a demand policy; the normal one has its own vectorized kernels.
+template<typename Demand>
+struct IntegratorFor {
+    using type = DemandIntegrator<Demand>;
+};
+
+template<>
+struct IntegratorFor<GaussianDemand> {
+    using type = ExplicitIntegrator;
+};
+
+
+inline unsigned plannerFlags(PlanRigor rigor) {
+    switch (rigor) {
+        case PlanRigor::measure:
+            return FFTW_MEASURE;
+        case PlanRigor::patient:
+            return FFTW_PATIENT;
+        case PlanRigor::estimate:
+            break;
+    }
+    return FFTW_ESTIMATE;
+}
+
+// The FFTW planner (creating and destroying plans, wisdom) is not thread-safe,
+// executing plans is.
+inline std::mutex &fftwPlannerMutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+inline bool loadFftwWisdom(const std::string &filename) {
+    std::lock_guard<std::mutex> lock(fftwPlannerMutex());
+    return fftw_import_wisdom_from_filename(filename.c_str()) != 0;
+}
+
+inline bool saveFftwWisdom(const std::string &filename) {
+    std::lock_guard<std::mutex> lock(fftwPlannerMutex());
+    return fftw_export_wisdom_to_filename(filename.c_str()) != 0;
+}
+
+// The FFTW calls of one precision: fftw_* for double, fftwf_* (the separate fftw3f library, see
+// PURCHASE_FORECAST_FLOAT) for float.
+template<typename Real>
+struct Fftw;
+
+template<>
+struct Fftw<double> {
+    using Complex = fftw_complex;
+    using Plan = fftw_plan;
+
+    static double *allocReal(size_t n) {
+        return fftw_alloc_real(n);
+    }
+
+    static Complex *allocComplex(size_t n) {
+        return fftw_alloc_complex(n);
+    }
+
+    static void free(void *ptr) {
+        fftw_free(ptr);
+    }
+
+    static Plan planR2c(int n, double *in, Complex *out, unsigned flags) {
+        return fftw_plan_dft_r2c_1d(n, in, out, flags);
+    }
+
+    static Plan planC2r(int n, Complex *in, double *out, unsigned flags) {
+        return fftw_plan_dft_c2r_1d(n, in, out, flags);
+    }
+
+    static Plan planDft(int n, Complex *in, Complex *out, int sign, unsigned flags) {
+        return fftw_plan_dft_1d(n, in, out, sign, flags);
+    }
+
+    static void execute(Plan plan) {
+        fftw_execute(plan);
+    }
+
+    static void executeR2c(Plan plan, double *in, Complex *out) {
+        fftw_execute_dft_r2c(plan, in, out);
+    }
+
+    static void executeDft(Plan plan, Complex *in, Complex *out) {
+        fftw_execute_dft(plan, in, out);
+    }
+
+    static void destroy(Plan plan) {
+        fftw_destroy_plan(plan);
+    }
+
+#ifdef PURCHASE_FORECAST_FFTW_THREADS
+    static bool initThreads() {
+        return fftw_init_threads() != 0;
+    }
 
-class GaussConvolution {
+    static void planWithThreads(int threads) {
+        fftw_plan_with_nthreads(threads);
+    }
+#endif
+};
+
+#ifdef PURCHASE_FORECAST_FLOAT
+template<>
+struct Fftw<float> {
+    using Complex = fftwf_complex;
+    using Plan = fftwf_plan;
+
+    static float *allocReal(size_t n) {
+        return fftwf_alloc_real(n);
+    }
+
+    static Complex *allocComplex(size_t n) {
+        return fftwf_alloc_complex(n);
+    }
+
+    static void free(void *ptr) {
+        fftwf_free(ptr);
+    }
+
+    static Plan planR2c(int n, float *in, Complex *out, unsigned flags) {
+        return fftwf_plan_dft_r2c_1d(n, in, out, flags);
+    }
+
+    static Plan planC2r(int n, Complex *in, float *out, unsigned flags) {
+        return fftwf_plan_dft_c2r_1d(n, in, out, flags);
+    }
+
+    static Plan planDft(int n, Complex *in, Complex *out, int sign, unsigned flags) {
+        return fftwf_plan_dft_1d(n, in, out, sign, flags);
+    }
+
+    static void execute(Plan plan) {
+        fftwf_execute(plan);
+    }
+
+    static void executeR2c(Plan plan, float *in, Complex *out) {
+        fftwf_execute_dft_r2c(plan, in, out);
+    }
+
+    static void executeDft(Plan plan, Complex *in, Complex *out) {
+        fftwf_execute_dft(plan, in, out);
+    }
+
+    static void destroy(Plan plan) {
+        fftwf_destroy_plan(plan);
+    }
+
+#ifdef PURCHASE_FORECAST_FFTW_THREADS
+    static bool initThreads() {
+        return fftwf_init_threads() != 0;
+    }
+
+    static void planWithThreads(int threads) {
+        fftwf_plan_with_nthreads(threads);
+    }
+#endif
+};
+#endif
+
+template<typename Real>
+struct FftwFree {
+    void operator()(void *ptr) const {
+        Fftw<Real>::free(ptr);
+    }
+};
+
+template<typename Real>
+struct FftwPlanDestroy {
+    void operator()(typename Fftw<Real>::Plan plan) const {
+        std::lock_guard<std::mutex> lock(fftwPlannerMutex());
+        Fftw<Real>::destroy(plan);
+    }
+};
+
+template<typename Real>
+using BasicFftwComplexBuffer = std::unique_ptr<typename Fftw<Real>::Complex[], FftwFree<Real>>;
+template<typename Real>
+using BasicFftwRealBuffer = std::unique_ptr<Real[], FftwFree<Real>>;
+template<typename Real>
+using BasicFftwPlan = std::unique_ptr<std::remove_pointer_t<typename Fftw<Real>::Plan>, FftwPlanDestroy<Real>>;
+
+using FftwComplexBuffer = BasicFftwComplexBuffer<double>;
+using FftwRealBuffer = BasicFftwRealBuffer<double>;
+using FftwPlan = BasicFftwPlan<double>;
+
+// Transform buffers and plans for one grid size. A workspace can be handed from
+// one GaussConvolution to the next (e.g. across the products a batch worker
+// solves), but must not be used by two threads at once.
+//
+// In builds with PURCHASE_FORECAST_FFTW_THREADS the transforms of at least
+// threadedFftSize points are planned for the given number of threads; below that
+// FFTW's thread start-up outweighs the work.
+//
+// Real is the scalar of the transforms, float for the reduced precisions (see Precision);
+// FFTW wisdom (loadFftwWisdom) only covers double plans.
+template<typename Real>
+class BasicFftWorkspace {
+public:
+    BasicFftWorkspace(size_t size, PlanRigor rigor = PlanRigor::estimate, FftMode fftMode = FftMode::real,
+                      unsigned threads = 1)
+            : n(size), rigor(rigor), mode(fftMode), threads(std::max(threads, 1u)),
+              spectrumSize(fftMode == FftMode::real ? size / 2 + 1 : size),
+              work(Fftw<Real>::allocComplex(spectrumSize)) {
+        // Planning with FFTW_MEASURE scribbles over the arrays, so plan before filling them.
+        const unsigned flags = plannerFlags(rigor);
+        const int length = static_cast<int>(n);
+        std::lock_guard<std::mutex> lock(fftwPlannerMutex());
+        const auto start = std::chrono::steady_clock::now();
+#ifdef PURCHASE_FORECAST_FFTW_THREADS
+        static const bool threadsReady = Fftw<Real>::initThreads();
+        Fftw<Real>::planWithThreads(threadsReady && n >= threadedFftSize ? static_cast<int>(this->threads) : 1);
+#endif
+        if (mode == FftMode::real) {
+            signal.reset(Fftw<Real>::allocReal(n));
+            forward.reset(Fftw<Real>::planR2c(length, signal.get(), work.get(), flags));
+            backward.reset(Fftw<Real>::planC2r(length, work.get(), signal.get(), flags));
+        } else {
+            forward.reset(Fftw<Real>::planDft(length, work.get(), work.get(), FFTW_FORWARD, flags));
+            backward.reset(Fftw<Real>::planDft(length, work.get(), work.get(), FFTW_BACKWARD, flags));
+        }
+#ifdef PURCHASE_FORECAST_FFTW_THREADS
+        Fftw<Real>::planWithThreads(1);
+#endif
+        planSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    size_t bytes() const {
+        return spectrumSize * sizeof(typename Fftw<Real>::Complex) + (signal ? n * sizeof(Real) : 0);
+    }
+
+    BasicFftWorkspace(const BasicFftWorkspace &) = delete;
+    BasicFftWorkspace &operator=(const BasicFftWorkspace &) = delete;
+
+    static constexpr size_t threadedFftSize = size_t{1} << 15;
+
+    const size_t n;
+    const PlanRigor rigor;
+    const FftMode mode;
+    const unsigned threads;
+    const size_t spectrumSize;
+    BasicFftwComplexBuffer<Real> work;
+    BasicFftwRealBuffer<Real> signal;
+    BasicFftwPlan<Real> forward;
+    BasicFftwPlan<Real> backward;
+    // Planning time, reported once to the first SolveStats attached (see GaussConvolution::setStats).
+    double planSeconds = 0.0;
+    bool planningReported = false;
+};
+
+using FftWorkspace = BasicFftWorkspace<double>;
+
+// Plans transforming count series of n points at once (fftw_plan_many_dft), series k at
+// signal + k * n and its spectrum at work + k * spectrumSize; see DemandConvolution::calculateBatch.
+class BatchFftWorkspace {
+public:
+    BatchFftWorkspace(size_t size, size_t count_, PlanRigor rigor = PlanRigor::estimate,
+                      FftMode fftMode = FftMode::real, unsigned threads = 1)
+            : n(size), count(count_), mode(fftMode), threads(std::max(threads, 1u)),
+              spectrumSize(fftMode == FftMode::real ? size / 2 + 1 : size), work(fftw_alloc_complex(spectrumSize * count)) {
+        const unsigned flags = plannerFlags(rigor);
+        const int length = static_cast<int>(n);
+        const int howMany = static_cast<int>(count);
+        const int spectrumDist = static_cast<int>(spectrumSize);
+        std::lock_guard<std::mutex> lock(fftwPlannerMutex());
+#ifdef PURCHASE_FORECAST_FFTW_THREADS
+        static const bool threadsReady = fftw_init_threads() != 0;
+        fftw_plan_with_nthreads(threadsReady && n * count >= FftWorkspace::threadedFftSize
+                                ? static_cast<int>(this->threads) : 1);
+#endif
+        if (mode == FftMode::real) {
+            signal.reset(fftw_alloc_real(n * count));
+            forward.reset(fftw_plan_many_dft_r2c(1, &length, howMany, signal.get(), nullptr, 1, length,
+                                                 work.get(), nullptr, 1, spectrumDist, flags));
+            backward.reset(fftw_plan_many_dft_c2r(1, &length, howMany, work.get(), nullptr, 1, spectrumDist,
+                                                  signal.get(), nullptr, 1, length, flags));
+        } else {
+            forward.reset(fftw_plan_many_dft(1, &length, howMany, work.get(), nullptr, 1, length,
+                                             work.get(), nullptr, 1, length, FFTW_FORWARD, flags));
+            backward.reset(fftw_plan_many_dft(1, &length, howMany, work.get(), nullptr, 1, length,
+                                              work.get(), nullptr, 1, length, FFTW_BACKWARD, flags));
+        }
+#ifdef PURCHASE_FORECAST_FFTW_THREADS
+        fftw_plan_with_nthreads(1);
+#endif
+    }
+
+    BatchFftWorkspace(const BatchFftWorkspace &) = delete;
+    BatchFftWorkspace &operator=(const BatchFftWorkspace &) = delete;
+
+    const size_t n;
+    const size_t count;
+    const FftMode mode;
+    const unsigned threads;
+    const size_t spectrumSize;
+    FftwComplexBuffer work;
+    FftwRealBuffer signal;
+    FftwPlan forward;
+    FftwPlan backward;
+};
+
+// Plans and the kernel spectrum live as long as the object, so a period costs
+// one forward and one inverse transform. The kernel is re-transformed only when
+// the distribution parameters actually change.
+//
+// FftMode::real runs r2c/c2r transforms on half-length spectra. It agrees with
+// FftMode::complex to within 1e-12 of max|result| (FFT round-off only).
+//
+// For narrow kernels (small sigma against the grid) the product is instead summed
+// directly over the taps within kernelSigmas standard deviations of the mean; with
+// ConvolutionMethod::automatic that is decided per period by comparing the tap count
+// with directCostRatio * log2(n), the rough FFT cost per point (PurchaseForecastBench
+// times both paths). The truncation error
+// is the kernel mass outside the window (below 1e-14 for the normal at 8 sigma).
+//
+// The kernel comes from the demand policy (see demand.h); GaussConvolution is the
+// normal-demand instance.
+//
+// With Real = float the series, kernel and transforms are single precision (see Precision); the
+// kernel is still evaluated in double and rounded once.
+template<typename Demand, typename Real = double>
+class DemandConvolution {
 public:
-    GaussConvolution(double expectedValue, double sigma, const std::vector<double> &x_)
-            : M{expectedValue}, s{sigma}, x(x_) {
-        exp_series = makeExpSeries();
-        x_coef = x[x.size() - 1] - x[0];
-    }
-
-    [[nodiscard]] std::vector<double> calculate(const std::vector<double> &source) const {
-        assert(exp_series.size() == source.size());
-        int n = exp_series.size();
-        int m = n/2;
-
-        std::vector<std::complex<double>> fft_exp(n);
-        std::vector<std::complex<double>> fft_func(n);
-        for (size_t i = 0; i < n; ++i) {
-            fft_func[i] = source[i];
-        }
-        fftw_plan plan_exp = fftw_plan_dft_1d(fft_func.size(), (fftw_complex *) &fft_func[0], (fftw_complex *) &fft_func[0],
-                                              FFTW_FORWARD, FFTW_ESTIMATE);
-        fftw_plan plan_func = fftw_plan_dft_1d(fft_exp.size(), (fftw_complex *) &exp_series[0], (fftw_complex *) &fft_exp[0],
-                                               FFTW_FORWARD, FFTW_ESTIMATE);
-        fftw_execute(plan_exp);
-        fftw_execute(plan_func);
-        std::vector<std::complex<double>> conv(n);
-        for (size_t i = 0; i < conv.size(); ++i) {
-            conv[i] = fft_exp[i] * fft_func[i];
-        }
-        fftw_plan plan_res = fftw_plan_dft_1d(conv.size(), (fftw_complex *) &conv[0], (fftw_complex *) &conv[0], FFTW_BACKWARD,
-                                              FFTW_ESTIMATE);
-        fftw_execute(plan_res);
-        std::vector<double> result(m);
-        const double coef = x_coef / (static_cast<double>(n) * static_cast<double>(n-1) * s *s);
-        for (size_t i = 0; i < result.size(); ++i) {
-            result[i] = real(conv[i]) * coef;
-        }
-
-        fftw_destroy_plan(plan_exp);
-        fftw_destroy_plan(plan_func);
-        fftw_destroy_plan(plan_res);
+    using Workspace = BasicFftWorkspace<Real>;
+
+    // The grid is workspace->n points evenly spaced over [front, back].
+    DemandConvolution(double expectedValue, double sigma, double front, double back,
+                      std::shared_ptr<Workspace> workspace_, Demand demand_ = Demand{})
+            : M{expectedValue}, s{sigma}, x_front(front), n(workspace_->n), workspace(std::move(workspace_)),
+              kernel(Fftw<Real>::allocComplex(workspace->spectrumSize)), demand(std::move(demand_)) {
+        x_coef = back - front;
+        demand.setParams({M, s});
+        const auto start = std::chrono::steady_clock::now();
+        updateKernel();
+        initialKernelSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    DemandConvolution(double expectedValue, double sigma, const std::vector<double> &x_,
+                      std::shared_ptr<Workspace> workspace_, Demand demand_ = Demand{})
+            : DemandConvolution(expectedValue, sigma, x_.front(), x_.back(), std::move(workspace_), std::move(demand_)) {
+        assert(workspace->n == x_.size());
+    }
+
+    DemandConvolution(double expectedValue, double sigma, const std::vector<double> &x_,
+                      PlanRigor rigor = PlanRigor::estimate, FftMode fftMode = FftMode::real, Demand demand_ = Demand{})
+            : DemandConvolution(expectedValue, sigma, x_, std::make_shared<Workspace>(x_.size(), rigor, fftMode),
+                                std::move(demand_)) {
+    }
+
+    DemandConvolution(const DemandConvolution &) = delete;
+    DemandConvolution &operator=(const DemandConvolution &) = delete;
+
+    [[nodiscard]] std::vector<Real> calculate(const std::vector<Real> &source) {
+        assert(n == source.size());
+        std::vector<Real> result(n / 2);
+        SOLVE_ALLOC(stats, Stage::inverseFft, result.size() * sizeof(Real));
+        calculate(source.data(), result.data());
         return result;
     }
 
+    // n source points in, the n / 2 points of the result for y >= 0 out; does not allocate.
+    void calculate(const Real *source, Real *result) {
+        size_t m = n / 2;
+        if (direct) {
+            SOLVE_STAGE(stats, Stage::directConvolution);
+            const Real *from = source + m - lastTap;
+            const auto coef = static_cast<Real>(x_coef / static_cast<double>(n - 1));
+            forChunks(team, m, grain / std::max<size_t>(taps.size(), 1), [&](size_t begin, size_t end) {
+                directConvolution(from + begin, taps.data(), taps.size(), result + begin, end - begin, coef);
+            });
+            return;
+        }
+
+        auto *func = reinterpret_cast<std::complex<Real> *>(workspace->work.get());
+        const auto *spectrum = reinterpret_cast<const std::complex<Real> *>(kernel.get());
+        const bool real = workspace->mode == FftMode::real;
+        {
+            SOLVE_STAGE(stats, Stage::forwardFft);
+            if (real) {
+                std::copy(source, source + n, workspace->signal.get());
+            } else {
+                for (size_t i = 0; i < n; ++i) {
+                    func[i] = source[i];
+                }
+            }
+            Fftw<Real>::execute(workspace->forward.get());
+        }
+        {
+            SOLVE_STAGE(stats, Stage::spectrumProduct);
+            forChunks(team, workspace->spectrumSize, grain, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                    func[i] *= spectrum[i];
+                }
+            });
+        }
+        SOLVE_STAGE(stats, Stage::inverseFft);
+        Fftw<Real>::execute(workspace->backward.get());
+        const auto coef = static_cast<Real>(x_coef / (static_cast<double>(n) * static_cast<double>(n-1)));
+        if (real) {
+            for (size_t i = 0; i < m; ++i) {
+                result[i] = workspace->signal[i] * coef;
+            }
+        } else {
+            for (size_t i = 0; i < m; ++i) {
+                result[i] = func[i].real() * coef;
+            }
+        }
+    }
+
+    // count sources of n points (source k at sources + k * n) convolved with the one kernel as
+    // calculate() would, result k at results + k * (n / 2); the transforms run as one batch.
+    // Double precision only.
+    void calculateBatch(const double *sources, double *results, size_t count, BatchFftWorkspace &batch) {
+        static_assert(std::is_same_v<Real, double>, "batched transforms are double precision");
+        const size_t m = n / 2;
+        if (direct) {
+            SOLVE_STAGE(stats, Stage::directConvolution);
+            const double coef = x_coef / static_cast<double>(n - 1);
+            forChunks(team, count, 1, [&](size_t begin, size_t end) {
+                for (size_t k = begin; k < end; ++k) {
+                    directConvolution(sources + k * n + m - lastTap, taps.data(), taps.size(), results + k * m, m, coef);
+                }
+            });
+            return;
+        }
+
+        assert(batch.n == n && batch.mode == workspace->mode && batch.count == count);
+        const size_t spectrumSize = batch.spectrumSize;
+        auto *func = reinterpret_cast<std::complex<double> *>(batch.work.get());
+        const auto *spectrum = reinterpret_cast<const std::complex<double> *>(kernel.get());
+        const bool real = batch.mode == FftMode::real;
+        {
+            SOLVE_STAGE(stats, Stage::forwardFft);
+            if (real) {
+                std::copy(sources, sources + count * n, batch.signal.get());
+            } else {
+                for (size_t i = 0; i < count * n; ++i) {
+                    func[i] = sources[i];
+                }
+            }
+            fftw_execute(batch.forward.get());
+        }
+        {
+            SOLVE_STAGE(stats, Stage::spectrumProduct);
+            forChunks(team, count, 1, [&](size_t begin, size_t end) {
+                for (size_t k = begin; k < end; ++k) {
+                    std::complex<double> *series = func + k * spectrumSize;
+                    for (size_t i = 0; i < spectrumSize; ++i) {
+                        series[i] *= spectrum[i];
+                    }
+                }
+            });
+        }
+        SOLVE_STAGE(stats, Stage::inverseFft);
+        fftw_execute(batch.backward.get());
+        const double coef = x_coef / (static_cast<double>(n) * static_cast<double>(n-1));
+        for (size_t k = 0; k < count; ++k) {
+            if (real) {
+                for (size_t i = 0; i < m; ++i) {
+                    results[k * m + i] = batch.signal[k * n + i] * coef;
+                }
+            } else {
+                for (size_t i = 0; i < m; ++i) {
+                    results[k * m + i] = func[k * n + i].real() * coef;
+                }
+            }
+        }
+    }
+
     void setDistributionParams(GaussDestrParameters params) {
+        if (params.mean == M && params.sigma == s) {
+            return;
+        }
         M = params.mean;
         s = params.sigma;
-        NormCoeff = s / std::sqrt(2.0 * M_PI);
-        ConstantInExp = -1.0 / (2.0 * s * s);
-        exp_series = makeExpSeries();
+        demand.setParams(params);
+        updateKernel();
+    }
+
+    void setMethod(ConvolutionMethod method_, double kernelSigmas_ = 8.0) {
+        method = method_;
+        kernelSigmas = kernelSigmas_;
+        updateKernel();
+    }
+
+    [[nodiscard]] bool isDirect() const {
+        return direct;
+    }
+
+    // Splits the direct sum and the spectrum product over the team; the transforms themselves
+    // are threaded by the workspace's plans.
+    void setThreads(ThreadTeam *team_) {
+        team = team_;
+    }
+
+    // Also reports the not yet reported planning time of the workspace and the kernel set up by the constructor.
+    void setStats(SolveStats *stats_) {
+        stats = stats_;
+        if (!stats) {
+            return;
+        }
+        if (SolveStats::enabled() && !workspace->planningReported) {
+            workspace->planningReported = true;
+            stats->record(Stage::planning, workspace->planSeconds, workspace->bytes());
+        }
+        if (SolveStats::enabled()) {
+            stats->record(Stage::kernel, initialKernelSeconds, workspace->spectrumSize * sizeof(typename Fftw<Real>::Complex));
+        }
     }
 
 private:
-    [[nodiscard]] std::vector<std::complex<double>> makeExpSeries() const {
-        size_t m = x.size()/2;
-        std::vector<std::complex<double>> result(x.size(), 0.0);
-        for (size_t i = m; i < x.size(); ++i) {
-            double arg = M - x[i];
-            result[i] = std::exp(ConstantInExp * arg * arg) * NormCoeff;
+    // In double whatever Real is.
+    double kernelAt(size_t i) const {
+        if (i < n / 2) {
+            return 0.0;
+        }
+        const double step = x_coef / static_cast<double>(n - 1);
+        return demand.kernel(x_front + static_cast<double>(i) * step, step, i == n / 2);
+    }
+
+    // Kernel index d (grid point n / 2 + d) holds demand (d + 0.5) * step.
+    void updateKernel() {
+        const size_t m = n / 2;
+        const double step = x_coef / static_cast<double>(n - 1);
+        auto tapIndex = [&](double demand) {
+            return static_cast<size_t>(std::clamp(demand / step - 0.5, 0.0, static_cast<double>(m - 1)));
+        };
+        firstTap = tapIndex(M - kernelSigmas * s);
+        lastTap = std::max(firstTap, std::min(tapIndex(M + kernelSigmas * s) + 1, m - 1));
+        const size_t width = lastTap - firstTap + 1;
+        direct = method == ConvolutionMethod::direct
+                 || (method == ConvolutionMethod::automatic
+                     && static_cast<double>(width) < directCostRatio * std::log2(static_cast<double>(n)));
+        if (!direct) {
+            updateKernelSpectrum();
+            return;
+        }
+        SOLVE_STAGE(stats, Stage::kernel);
+        // Reversed, so that the sum runs forward over the source. Room for the widest window, m taps,
+        // is reserved on the first direct period so later ones do not reallocate.
+        taps.reserve(m);
+        taps.resize(width);
+        for (size_t t = 0; t < width; ++t) {
+            taps[t] = static_cast<Real>(kernelAt(m + lastTap - t));
+        }
+    }
+
+    void updateKernelSpectrum() {
+        SOLVE_STAGE(stats, Stage::kernel);
+        if (workspace->mode == FftMode::real) {
+            Real *series = workspace->signal.get();
+            for (size_t i = 0; i < n; ++i) {
+                series[i] = static_cast<Real>(kernelAt(i));
+            }
+            Fftw<Real>::executeR2c(workspace->forward.get(), series, kernel.get());
+        } else {
+            auto *series = reinterpret_cast<std::complex<Real> *>(kernel.get());
+            for (size_t i = 0; i < n; ++i) {
+                series[i] = static_cast<Real>(kernelAt(i));
+            }
+            Fftw<Real>::executeDft(workspace->forward.get(), kernel.get(), kernel.get());
         }
-        return result;
     }
 
 private:
     double M;
     double s;
     double x_coef;
-    std::vector<std::complex<double>> exp_series;
-    const std::vector<double> x;
-    double NormCoeff = s / std::sqrt(2.0 * M_PI);
-    double ConstantInExp = -1.0 / (2.0 * s * s);
+    const double x_front;
+    const size_t n;
+    std::shared_ptr<Workspace> workspace;
+    BasicFftwComplexBuffer<Real> kernel;
+    SolveStats *stats = nullptr;
+    double initialKernelSeconds = 0.0;
+    Demand demand;
+    ConvolutionMethod method = ConvolutionMethod::automatic;
+    double kernelSigmas = 8.0;
+    bool direct = false;
+    size_t firstTap = 0;
+    size_t lastTap = 0;
+    std::vector<Real> taps;
+    ThreadTeam *team = nullptr;
+    static constexpr double directCostRatio = 8.0;
+    // Multiply-adds below which a loop is not worth splitting.
+    static constexpr size_t grain = size_t{1} << 14;
 };
+
+using GaussConvolution = DemandConvolution<GaussianDemand>;
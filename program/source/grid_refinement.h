@@ -0,0 +1,102 @@
+#pragma once
+
+#include "manager.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <vector>
+
+// Accuracy asked of a solve instead of a grid size. Zero leaves that quantity unchecked.
+struct GridTolerance {
+    double goods = 0.0;        // on y_max, units of goods
+    double money = 0.0;        // on profit_max, units of money
+    int minDots = 256;
+    int maxDots = 1 << 20;
+
+    [[nodiscard]] bool enabled() const {
+        return goods > 0.0 || money > 0.0;
+    }
+};
+
+struct GridRefinement {
+    int dotsNum = 0;           // grid of the returned solve
+    double goodsError = 0.0;   // change of y_max, profit_max and the answers from the grid half as fine
+    double moneyError = 0.0;
+    int solves = 0;
+    bool met = false;          // false when maxDots was reached (or the solve was stopped) first
+};
+
+// The solver spans [-(mean + 3 sigma), mean + 3 sigma] whatever the grid size (see BasicTaskCalculator).
+inline double gridStep(GaussDestrParameters gridDestr, int dotsNum) {
+    return 2.0 * (gridDestr.mean + 3.0 * gridDestr.sigma) / (dotsNum - 1);
+}
+
+// Coarsest power-of-two grid worth solving for a goods tolerance: y_max sits on grid points, so its
+// error is at least half a step; the first grid is chosen so that the one after it has a step of
+// at most twice the tolerance and the pair already gives an error estimate.
+inline int firstGridSize(GaussDestrParameters gridDestr, const GridTolerance &tolerance) {
+    int dotsNum = std::max(tolerance.minDots, 4);
+    while (tolerance.goods > 0.0 && 2 * dotsNum <= tolerance.maxDots
+           && gridStep(gridDestr, 2 * dotsNum) > 2.0 * tolerance.goods) {
+        dotsNum *= 2;
+    }
+    return std::min(dotsNum, tolerance.maxDots);
+}
+
+// Solves on doubling grids, from firstGridSize on, until y_max, profit_max and the first-period
+// answers for stocks (order-up-to level, period and total profit) change by no more than the
+// tolerance between two grids, and returns the finer solve. The change is the error estimate of
+// the coarser grid, so it overstates the error of the returned one.
+// make(dotsNum) builds a calculator; run(calculator) solves it and returns false to give up.
+template<typename Make, typename Run>
+auto refineGrid(GaussDestrParameters gridDestr, const GridTolerance &tolerance, const std::vector<double> &stocks,
+                GridRefinement &refinement, Make make, Run run) -> decltype(make(0)) {
+    refinement = GridRefinement{};
+    int dotsNum = firstGridSize(gridDestr, tolerance);
+    auto coarse = make(dotsNum);
+    ++refinement.solves;
+    if (!run(*coarse)) {
+        return nullptr;
+    }
+    refinement.dotsNum = dotsNum;
+    while (2 * dotsNum <= tolerance.maxDots) {
+        dotsNum *= 2;
+        auto fine = make(dotsNum);
+        ++refinement.solves;
+        if (!run(*fine)) {
+            return coarse;
+        }
+        const auto &coarseY = coarse->getMaxY(), &fineY = fine->getMaxY();
+        const auto &coarseProfit = coarse->getMaxProfit(), &fineProfit = fine->getMaxProfit();
+        refinement.goodsError = 0.0;
+        refinement.moneyError = 0.0;
+        for (size_t k = 0; k < fineY.size(); ++k) {
+            refinement.goodsError = std::max(refinement.goodsError, std::abs(fineY[k] - coarseY[k]));
+            refinement.moneyError = std::max(refinement.moneyError, std::abs(fineProfit[k] - coarseProfit[k]));
+        }
+        const auto coarseAnswers = coarse->getAnswers(stocks), fineAnswers = fine->getAnswers(stocks);
+        for (size_t q = 0; q < stocks.size(); ++q) {
+            const auto &a = coarseAnswers[q], &b = fineAnswers[q];
+            if (!a || !b) {
+                if (a || b) {
+                    refinement.goodsError = std::numeric_limits<double>::infinity();
+                    refinement.moneyError = std::numeric_limits<double>::infinity();
+                }
+                continue;
+            }
+            refinement.goodsError = std::max(refinement.goodsError, std::abs(b->y - a->y));
+            refinement.moneyError = std::max({refinement.moneyError, std::abs(b->thisPeriodProfit - a->thisPeriodProfit),
+                                              std::abs(b->MaxProfit - a->MaxProfit)});
+        }
+        refinement.dotsNum = dotsNum;
+        coarse = std::move(fine);
+        if ((tolerance.goods <= 0.0 || refinement.goodsError <= tolerance.goods)
+            && (tolerance.money <= 0.0 || refinement.moneyError <= tolerance.money)) {
+            refinement.met = true;
+            break;
+        }
+    }
+    return coarse;
+}
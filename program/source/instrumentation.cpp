@@ -0,0 +1,91 @@
+#include "instrumentation.h"
+
+#include <iomanip>
+
+const char *stageName(Stage stage) {
+    switch (stage) {
+        case Stage::setup:
+            return "setup";
+        case Stage::planning:
+            return "planning";
+        case Stage::kernel:
+            return "kernel";
+        case Stage::forwardFft:
+            return "forward_fft";
+        case Stage::spectrumProduct:
+            return "spectrum_product";
+        case Stage::inverseFft:
+            return "inverse_fft";
+        case Stage::directConvolution:
+            return "direct_convolution";
+        case Stage::integrator:
+            return "integrator";
+        case Stage::argmax:
+            return "argmax";
+        case Stage::answer:
+            return "answer";
+    }
+    return "unknown";
+}
+
+namespace {
+
+void writeTable(std::ostream &out, const StageTable &table) {
+    bool first = true;
+    for (size_t i = 0; i < stageCount; ++i) {
+        const auto &it = table[i];
+        if (it.calls == 0 && it.bytes == 0) {
+            continue;
+        }
+        out << (first ? "" : ", ") << "\"" << stageName(static_cast<Stage>(i)) << "\": {\"seconds\": " << it.seconds
+            << ", \"calls\": " << it.calls << ", \"bytes\": " << it.bytes << "}";
+        first = false;
+    }
+}
+
+}
+
+void writeStatsJson(std::ostream &out, const SolveStats &stats) {
+    const auto precision = out.precision(9);
+    out << "{\n  \"enabled\": " << (SolveStats::enabled() ? "true" : "false") << ",\n  \"total\": {";
+    writeTable(out, stats.total);
+    out << "},\n  \"periods\": [";
+    for (size_t k = 0; k < stats.periods.size(); ++k) {
+        out << (k == 0 ? "\n" : ",\n") << "    {\"period\": " << k;
+        bool empty = true;
+        for (const auto &it: stats.periods[k]) {
+            empty = empty && it.calls == 0 && it.bytes == 0;
+        }
+        if (!empty) {
+            out << ", ";
+            writeTable(out, stats.periods[k]);
+        }
+        out << "}";
+    }
+    out << (stats.periods.empty() ? "]\n}\n" : "\n  ]\n}\n");
+    out.precision(precision);
+}
+
+void writeStatsTable(std::ostream &out, const SolveStats &stats) {
+    if (!SolveStats::enabled()) {
+        out << "Instrumentation is disabled in this build\n";
+        return;
+    }
+    const auto flags = out.flags();
+    const auto precision = out.precision();
+    double seconds = 0.0;
+    for (const auto &it: stats.total) {
+        seconds += it.seconds;
+    }
+    out << std::left << std::setw(18) << "stage" << std::right << std::setw(12) << "ms" << std::setw(8) << "%"
+        << std::setw(10) << "calls" << std::setw(14) << "KiB" << "\n";
+    for (size_t i = 0; i < stageCount; ++i) {
+        const auto &it = stats.total[i];
+        out << std::left << std::setw(18) << stageName(static_cast<Stage>(i)) << std::right << std::fixed
+            << std::setprecision(3) << std::setw(12) << it.seconds * 1e3 << std::setprecision(1) << std::setw(8)
+            << (seconds > 0.0 ? 100.0 * it.seconds / seconds : 0.0) << std::setw(10) << it.calls << std::setw(14)
+            << static_cast<double>(it.bytes) / 1024.0 << "\n";
+    }
+    out.flags(flags);
+    out.precision(precision);
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+// Per-stage wall time, call counts and allocated bytes of a solve. The probes are
+// compiled in only with PURCHASE_FORECAST_INSTRUMENTATION defined; otherwise
+// SOLVE_STAGE/SOLVE_ALLOC expand to nothing and SolveStats stays empty.
+enum class Stage {
+    setup,
+    planning,
+    kernel,
+    forwardFft,
+    spectrumProduct,
+    inverseFft,
+    directConvolution,
+    integrator,
+    argmax,
+    answer,
+};
+
+constexpr size_t stageCount = static_cast<size_t>(Stage::answer) + 1;
+
+const char *stageName(Stage stage);
+
+struct StageStats {
+    double seconds = 0.0;
+    uint64_t calls = 0;
+    uint64_t bytes = 0;
+};
+
+using StageTable = std::array<StageStats, stageCount>;
+
+struct SolveStats {
+    static constexpr bool enabled() {
+#ifdef PURCHASE_FORECAST_INSTRUMENTATION
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    // Clears everything and sizes the per-period tables; work done outside
+    // calcPeriod (setup, planning, answers) only shows up in total.
+    void reset(int periodsNum) {
+        total = {};
+        periods.assign(enabled() && periodsNum > 0 ? periodsNum : 0, StageTable{});
+        period = -1;
+    }
+
+    void record(Stage stage, double seconds, size_t bytes = 0) {
+        record(stage, seconds, bytes, period);
+    }
+
+    void record(Stage stage, double seconds, size_t bytes, int atPeriod) {
+        auto apply = [&](StageStats &it) {
+            it.seconds += seconds;
+            it.calls += 1;
+            it.bytes += bytes;
+        };
+        apply(total[static_cast<size_t>(stage)]);
+        if (atPeriod >= 0 && static_cast<size_t>(atPeriod) < periods.size()) {
+            apply(periods[atPeriod][static_cast<size_t>(stage)]);
+        }
+    }
+
+    void allocated(Stage stage, size_t bytes) {
+        total[static_cast<size_t>(stage)].bytes += bytes;
+        if (period >= 0 && static_cast<size_t>(period) < periods.size()) {
+            periods[period][static_cast<size_t>(stage)].bytes += bytes;
+        }
+    }
+
+    StageTable total{};
+    std::vector<StageTable> periods;
+    int period = -1;
+};
+
+// {"enabled": ..., "total": {stage: {...}}, "periods": [{"period": k, stage: {...}}, ...]}
+void writeStatsJson(std::ostream &out, const SolveStats &stats);
+
+// Plain-text table of the totals, as shown in the GUI.
+void writeStatsTable(std::ostream &out, const SolveStats &stats);
+
+class StageTimer {
+public:
+    StageTimer(SolveStats *stats_, Stage stage_, size_t bytes_ = 0)
+            : stats(stats_), stage(stage_), bytes(bytes_), period(stats_ ? stats_->period : -1),
+              start(std::chrono::steady_clock::now()) {
+    }
+
+    StageTimer(const StageTimer &) = delete;
+    StageTimer &operator=(const StageTimer &) = delete;
+
+    ~StageTimer() {
+        if (stats) {
+            stats->record(stage, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), bytes, period);
+        }
+    }
+
+private:
+    SolveStats *stats;
+    Stage stage;
+    size_t bytes;
+    int period;
+    std::chrono::steady_clock::time_point start;
+};
+
+#ifdef PURCHASE_FORECAST_INSTRUMENTATION
+#define SOLVE_STAGE_NAME2(line) solveStage##line
+#define SOLVE_STAGE_NAME(line) SOLVE_STAGE_NAME2(line)
+// Times the rest of the enclosing scope.
+#define SOLVE_STAGE(stats, stage) StageTimer SOLVE_STAGE_NAME(__LINE__)((stats), (stage))
+#define SOLVE_ALLOC(stats, stage, bytes) \
+    do { if (stats) (stats)->allocated((stage), (bytes)); } while (false)
+#else
+#define SOLVE_STAGE(stats, stage) ((void) 0)
+#define SOLVE_ALLOC(stats, stage, bytes) ((void) 0)
+#endif
@@ -1,11 +1,20 @@
 #include "mainwindow.h"
+#include "equations.h"
 
 #include <QApplication>
+#include <QDir>
+#include <QStandardPaths>
 
 int main(int argc, char *argv[])
 {
     QApplication a(argc, argv);
     MainWindow w;
+    const QString wisdomDir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+    const std::string wisdomFile = QDir(wisdomDir).filePath("fftw.wisdom").toStdString();
+    loadFftwWisdom(wisdomFile);
     w.show();
-    return a.exec();
+    int res = a.exec();
+    QDir().mkpath(wisdomDir);
+    saveFftwWisdom(wisdomFile);
+    return res;
 }
@@ -1,8 +1,12 @@
 #include "mainwindow.h"
 #include "./ui_mainwindow.h"
 #include "manager.h"
+#include "period_aggregator.h"
+#include "sales_reader.h"
 
+#include <QBoxLayout>
 #include <QMessageBox>
+#include <QProgressBar>
 #include <QSettings>
 #include <QFileDialog>
 
@@ -87,7 +91,19 @@ MainWindow::MainWindow(QWidget *parent)
     addTip(ui->info_7, QString("Напечатайте значение инфляции за рассматриваемый период."));
     addTip(ui->info_8, QString("Напечатайте количество единиц имеющего запаса на начало первого рассматриваемого периода."));
 
-    addTip(ui->info_9, QString("Это значение пропорционально степени двойки. Используется при построении сетки. Чем больше - тем точнее рассчеты."));
+    addTip(ui->info_9, QString("Это значение пропорционально степени двойки. Используется при построении сетки. Чем больше - тем точнее рассчеты. "
+                               "Если задана точность, сетка подбирается сама, начиная с этого размера."));
+
+    // Accuracy instead of grid size: the grid is doubled until the order-up-to levels change by less than this.
+    toleranceSpinBox = new QDoubleSpinBox(this);
+    toleranceSpinBox->setRange(0.0, 1e6);
+    toleranceSpinBox->setDecimals(3);
+    toleranceSpinBox->setSpecialValueText(QString("Точность: вручную"));
+    toleranceSpinBox->setPrefix(QString("Точность: "));
+    toleranceSpinBox->setToolTip(QString("Допустимая ошибка объёма закупки, единиц товара"));
+    if(auto *layout = qobject_cast<QBoxLayout*>(ui->horizontalSlider->parentWidget()->layout())){
+        layout->insertWidget(layout->indexOf(ui->horizontalSlider) + 1, toleranceSpinBox);
+    }
 
     connect(ui->meanEdit, QOverload<double>::of(&QDoubleSpinBox::valueChanged), this, [this](double res){
         gaussDestr.mean = res;
@@ -119,6 +135,9 @@ MainWindow::MainWindow(QWidget *parent)
     connect(ui->horizontalSlider, QOverload<int>::of(&QSlider::valueChanged), this, [this](int res){
         dotsNum = 1 << res;
     });
+    connect(toleranceSpinBox, QOverload<double>::of(&QDoubleSpinBox::valueChanged), this, [this](double res){
+        tolerance.goods = res;
+    });
     connect(ui->PeriodComboBox, QOverload<int>::of(&QComboBox::currentIndexChanged), this, [this](int index){
         if(index == 0){
             period = Period::day;
@@ -127,6 +146,10 @@ MainWindow::MainWindow(QWidget *parent)
         } else if(index == 2){
             period = Period::month;
         }
+        if(history){
+            gaussVec = history->get(period).periods();
+            ui->chooseFileText->setText(QString::number(gaussVec.size()).append(" periods were found"));
+        }
     });
     connect(ui->clearPushButton, &QPushButton::clicked, [this]{
         ui->meanEdit->setValue(0.0);
@@ -144,41 +167,56 @@ MainWindow::MainWindow(QWidget *parent)
         gaussDestr = {};
         cur_x = 0.0;
         dotsNum = 1024;
+        toleranceSpinBox->setValue(0.0);
         y_max = {};
         profit_max = {};
     });
 
-    connect(ui->startPushButton, &QPushButton::clicked, this, [this]{
-        auto gauss_for_init = gaussDestr;
-        if(!gaussVec.empty() && ui->noStatRadioButton->isChecked()){
-            for(const auto& it : gaussVec){
-                gauss_for_init.mean = std::max(gauss_for_init.mean, it.mean);
-                gauss_for_init.sigma = std::max(gauss_for_init.sigma, it.sigma);
-            }
-        }
-        TaskCalculator calculator(params, gauss_for_init, periodsNum, dotsNum);
-        int n = 1;
-        if(!gaussVec.empty()  && ui->noStatRadioButton->isChecked()){
-            calculator.setGaussVector(gaussVec);
+    qRegisterMetaType<SolveResult>();
+    worker = new SolveWorker;
+    worker->moveToThread(&solverThread);
+    connect(&solverThread, &QThread::finished, worker, &QObject::deleteLater);
+    connect(worker, &SolveWorker::progress, this, [this](quint64 id, int done, int total){
+        if(id != solveId){
+            return;
         }
-        while(calculator.calcPeriod()){
-            ui->statusbar->showMessage(QLatin1String("Period ") + QString::number(n));
-            n++;
+        progressBar->setRange(0, total);
+        progressBar->setValue(done);
+        ui->statusbar->showMessage(QLatin1String("Period ") + QString::number(done));
+    });
+    connect(worker, &SolveWorker::finished, this, &MainWindow::showResult);
+    connect(worker, &SolveWorker::cancelled, this, [this](quint64 id){
+        if(id == solveId){
+            stopSolve();
         }
-        ui->statusbar->clearMessage();
-        y_max = calculator.getMaxY();
-        profit_max = calculator.getMaxProfit();
-        std::optional<Answer> ans = calculator.getAnswer(cur_x);
-        double yRes = ((ans->y - cur_x) < 0.01) ? 0.0 : (ans->y - cur_x);
-        ui->doubleSpinBox_9->setValue(yRes);
-        ui->doubleSpinBox_10->setValue(ans->thisPeriodProfit);
-        ui->doubleSpinBox_11->setValue(ans->MaxProfit);
-        ui->resultWidget->setVisible(true);
-        ui->resultWidget_2->setVisible(true);
-        ui->resultWidget_3->setVisible(true);
+    });
+    solverThread.start();
 
+    progressBar = new QProgressBar(this);
+    progressBar->setVisible(false);
+    cancelButton = new QPushButton(QString("Отмена"), this);
+    cancelButton->setVisible(false);
+    ui->statusbar->addPermanentWidget(progressBar);
+    ui->statusbar->addPermanentWidget(cancelButton);
+    connect(cancelButton, &QPushButton::clicked, this, [this]{
+        worker->supersede(++solveId);
+        stopSolve();
+        ui->statusbar->showMessage(QString("Cancelled"), 3000);
     });
 
+    connect(ui->startPushButton, &QPushButton::clicked, this, &MainWindow::startSolve);
+
+    // Connected after the handlers above, so a restarted solve sees the new value.
+    for(auto *box : {ui->meanEdit, ui->sigmaEdit, ui->doubleSpinBox_3, ui->doubleSpinBox_4, ui->doubleSpinBox_5,
+                     ui->doubleSpinBox_6, ui->doubleSpinBox_7, ui->doubleSpinBox_8}){
+        connect(box, QOverload<double>::of(&QDoubleSpinBox::valueChanged), this, &MainWindow::restartIfRunning);
+    }
+    connect(ui->spinBox, QOverload<int>::of(&QSpinBox::valueChanged), this, &MainWindow::restartIfRunning);
+    connect(ui->horizontalSlider, &QSlider::valueChanged, this, &MainWindow::restartIfRunning);
+    connect(toleranceSpinBox, QOverload<double>::of(&QDoubleSpinBox::valueChanged), this, &MainWindow::restartIfRunning);
+    connect(ui->PeriodComboBox, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &MainWindow::restartIfRunning);
+    connect(ui->noStatRadioButton, &QRadioButton::toggled, this, &MainWindow::restartIfRunning);
+
     connect(ui->showResPushButton, &QPushButton::clicked, [this]{
         std::ostringstream out;
         for(int i = 0; i<y_max.size() ;++i){
@@ -192,16 +230,43 @@ MainWindow::MainWindow(QWidget *parent)
         }
     });
 
+    // Per-stage timings of the last solve; only useful in builds with PURCHASE_FORECAST_INSTRUMENTATION.
+    detailsButton = new QPushButton(QString("Детали"), this);
+    detailsButton->setVisible(false);
+    if(auto *layout = qobject_cast<QBoxLayout*>(ui->showResPushButton->parentWidget()->layout())){
+        layout->insertWidget(layout->indexOf(ui->showResPushButton) + 1, detailsButton);
+    }
+    connect(detailsButton, &QPushButton::clicked, [this]{
+        std::ostringstream table, json;
+        writeStatsTable(table, stats);
+        writeStatsJson(json, stats);
+        QMessageBox msgBox;
+        msgBox.setText(QString("<pre>") + QString::fromStdString(table.str()).toHtmlEscaped() + QString("</pre>"));
+        msgBox.setDetailedText(QString::fromStdString(json.str()));
+        msgBox.exec();
+    });
+
     connect(ui->savePushButton, &QPushButton::clicked, [this]{
         saveSettings(ui);
     });
 
     connect(ui->chooseFileButton, &QPushButton::clicked, [this]{
         auto fileName = QFileDialog::getOpenFileName(this, "Open purchcase file", {}, "Text files (*.txt)");
-        auto rawData = readFile(fileName.toStdString());
-        if(!rawData.empty()){
-            gaussVec = parsePeriods(rawData, period);
-            ui->chooseFileText->setText(QString::number(gaussVec.size()).append(" periods were found"));
+        std::vector<MalformedLine> errors;
+        HistoryAggregates aggregates;
+        auto rows = readSalesFile(fileName.toStdString(), [&aggregates](time_t date, double y){
+            aggregates.add(date, y);
+        }, &errors);
+        if(rows != 0){
+            history.emplace(std::move(aggregates));
+            gaussVec = history->get(period).periods();
+            QString text = QString::number(gaussVec.size()).append(" periods were found");
+            if(!errors.empty()){
+                text.append(", ").append(QString::number(errors.size())).append(" bad lines skipped (first: line ")
+                        .append(QString::number(errors.front().line)).append(")");
+            }
+            ui->chooseFileText->setText(text);
+            restartIfRunning();
         } else{
             ui->chooseFileText->setText(QString::fromStdString("File wasn't correct"));
         }
@@ -212,6 +277,78 @@ MainWindow::MainWindow(QWidget *parent)
 
 MainWindow::~MainWindow()
 {
+    worker->supersede(++solveId);
+    solverThread.quit();
+    solverThread.wait();
     delete ui;
 }
 
+void MainWindow::startSolve()
+{
+    std::vector<GaussDestrParameters> forecast;
+    if(ui->noStatRadioButton->isChecked()){
+        forecast = gaussVec;
+    }
+    SolveRequest request{params, gaussDestr, periodsNum, dotsNum, forecast, cur_x, tolerance};
+    quint64 id = ++solveId;
+    worker->supersede(id);
+    QMetaObject::invokeMethod(worker, [worker = worker, request, id]{
+        worker->solve(request, id);
+    }, Qt::QueuedConnection);
+    solving = true;
+    progressBar->setRange(0, 0);
+    progressBar->setVisible(true);
+    cancelButton->setVisible(true);
+}
+
+void MainWindow::restartIfRunning()
+{
+    if(solving){
+        startSolve();
+    }
+}
+
+void MainWindow::stopSolve()
+{
+    solving = false;
+    progressBar->setVisible(false);
+    cancelButton->setVisible(false);
+    ui->statusbar->clearMessage();
+}
+
+void MainWindow::showResult(quint64 id, const SolveResult &result)
+{
+    if(id != solveId){
+        return;
+    }
+    stopSolve();
+    y_max = result.y_max;
+    profit_max = result.profit_max;
+    stats = result.stats;
+    detailsButton->setVisible(SolveStats::enabled());
+    if(tolerance.enabled()){
+        ui->statusbar->showMessage(QString("Grid: ") + QString::number(result.dotsNum) + QString(" points")
+                                   + (result.cached ? QString(", cached") : QString()));
+    } else if(result.cached){
+        ui->statusbar->showMessage(QString("Cached result"), 5000);
+    }
+    if(!result.answer){
+        ui->doubleSpinBox_9->setValue(0.0);
+        ui->doubleSpinBox_10->setValue(0.0);
+        ui->doubleSpinBox_11->setValue(0.0);
+        ui->resultWidget->setVisible(false);
+        ui->resultWidget_2->setVisible(false);
+        ui->resultWidget_3->setVisible(false);
+        ui->statusbar->showMessage(QString("Current stock is outside of the grid"), 5000);
+        return;
+    }
+    const Answer &ans = *result.answer;
+    double yRes = ((ans.y - cur_x) < 0.01) ? 0.0 : (ans.y - cur_x);
+    ui->doubleSpinBox_9->setValue(yRes);
+    ui->doubleSpinBox_10->setValue(ans.thisPeriodProfit);
+    ui->doubleSpinBox_11->setValue(ans.MaxProfit);
+    ui->resultWidget->setVisible(true);
+    ui->resultWidget_2->setVisible(true);
+    ui->resultWidget_3->setVisible(true);
+}
+
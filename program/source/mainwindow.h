@@ -2,13 +2,22 @@
 #define MAINWINDOW_H
 
 #include <QMainWindow>
+#include <QThread>
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class MainWindow; }
 QT_END_NAMESPACE
 
 #include "models.h"
+#include "solveworker.h"
+#include "period_aggregator.h"
 
+#include <optional>
+
+
+class QDoubleSpinBox;
+class QProgressBar;
+class QPushButton;
 
 class MainWindow : public QMainWindow
 {
@@ -18,6 +27,12 @@ public:
     MainWindow(QWidget *parent = nullptr);
     ~MainWindow();
 
+private:
+    void startSolve();
+    void restartIfRunning();
+    void showResult(quint64 id, const SolveResult &result);
+    void stopSolve();
+
 private:
     Ui::MainWindow *ui;
     TaskParameters params{};
@@ -25,9 +40,20 @@ private:
     int periodsNum = 1;
     GaussDestrParameters gaussDestr{};
     std::vector<GaussDestrParameters> gaussVec{};
+    std::optional<HistoryAggregates> history{};
     double cur_x = 0.0;
     int dotsNum = 1024;
+    GridTolerance tolerance{};
     std::vector<double> y_max{};
     std::vector<double> profit_max{};
+    SolveStats stats{};
+    QThread solverThread;
+    SolveWorker *worker = nullptr;
+    quint64 solveId = 0;
+    bool solving = false;
+    QProgressBar *progressBar = nullptr;
+    QPushButton *cancelButton = nullptr;
+    QPushButton *detailsButton = nullptr;
+    QDoubleSpinBox *toleranceSpinBox = nullptr;
 };
 #endif // MAINWINDOW_H
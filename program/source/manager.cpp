@@ -0,0 +1,21 @@
+#include "manager.h"
+#include "period_aggregator.h"
+#include "sales_reader.h"
+
+std::vector<std::pair<time_t, double>> readFile(std::string filename) {
+    return readSalesFile(filename);
+}
+
+std::vector<GaussDestrParameters> parsePeriods(const std::vector<std::pair<time_t, double>> &raw, Period period) {
+    PeriodAggregator aggregator(period);
+    aggregator.add(raw);
+    return aggregator.periods();
+}
+
+std::vector<GaussDestrParameters> parsePeriods(const std::string &filename, Period period) {
+    PeriodAggregator aggregator(period);
+    readSalesFile(filename, [&aggregator](time_t date, double y) {
+        aggregator.add(date, y);
+    });
+    return aggregator.periods();
+}
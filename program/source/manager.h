@@ -2,121 +2,127 @@
 
 #include "models.h"
 #include "equations.h"
+#include "arena.h"
 #include <vector>
 #include <optional>
+#include <map>
+#include <numeric>
+#include <algorithm>
+#include <cmath>
 #include <limits>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <sstream>
 
 #include <chrono>
 #include <ctime>
 
 template<typename T>
-std::vector<T> linspace(T a, T b, size_t N) {
+void linspace(T a, T b, T *xs, size_t N) {
     T h = (b - a) / static_cast<T>(N - 1);
+    T val = a;
+    for (size_t i = 0; i < N; ++i, val += h)
+        xs[i] = val;
+}
+
+template<typename T>
+std::vector<T> linspace(T a, T b, size_t N) {
     std::vector<T> xs(N);
-    typename std::vector<T>::iterator x;
-    T val;
-    for (x = xs.begin(), val = a; x != xs.end(); ++x, val += h)
-        *x = val;
+    linspace(a, b, xs.data(), N);
     return xs;
 }
 
-std::vector<std::pair<time_t, double>> readFile(std::string filename) {
-    std::ifstream file(filename);
-    std::vector<std::pair<time_t, double>> result;
-    if (file.is_open()) {
-        std::string line;
-        if (!(getline(file, line) && line.find("Purchase Forecast file") != std::string::npos)) {
-            file.close();
-            return {};
-        }
-        tm date {};
-        double y{};
-        while (getline(file, line)) {
-            std::istringstream input(line);
-            input >> std::get_time(&date, "%d.%m.%Y") >> y;
-            time_t d = mktime(&date);
-            result.emplace_back(d, y);
-        }
-        file.close();
-    }
-    return result;
-}
+std::vector<std::pair<time_t, double>> readFile(std::string filename);
 
-std::vector<GaussDestrParameters> parsePeriods(const std::vector<std::pair<time_t, double>> &raw, Period period) {
-    std::vector<GaussDestrParameters> result;
-    int hours = 24;
-    switch (period) {
-        case Period::day:
-            break;
-        case Period::week:
-            hours *= 7;
-            break;
-        case Period::month:
-            hours *= 30;
-            break;
-    }
-    if(raw.size() == 0){
-        return {};
-    }
-    auto p = std::chrono::hours(hours);
-    double sum = 0.0;
-    int count = 0;
-    auto now = std::chrono::system_clock::from_time_t(raw[0].first);
-    auto nextPeriod = now + p;
-    std::vector<double> sigma;
-    for (const auto &[date, y]: raw) {
-        if(y == 0.0){
-            continue;
-        }
-        if (date < std::chrono::system_clock::to_time_t(nextPeriod)) {
-            sum += y;
-            sigma.push_back(y);
-        } else {
-            nextPeriod += p;
-            double stdErr;
-            double variance{0.0};
-            double sigma_gauss = sum / 3.0;
-            if(sigma.size() > 1){
-                double average = sum / (sigma.size());
-                for (const auto &x: sigma)
-                    variance += (x - average) * (x - average);
-                variance /= sigma.size() - 1;
-                sigma_gauss = std::sqrt(variance) * sigma.size();
-            }
-            if(sigma_gauss == 0){
-                sigma_gauss = 1.0;
-            }
-            result.push_back({sum, sigma_gauss});
-            sum = y;
-            sigma.clear();
-            sigma.push_back(y);
-        }
+std::vector<GaussDestrParameters> parsePeriods(const std::vector<std::pair<time_t, double>> &raw, Period period);
+
+// readFile and parsePeriods in one pass: the rows go straight into the aggregation and are not kept.
+std::vector<GaussDestrParameters> parsePeriods(const std::string &filename, Period period);
+
+// Distribution the grid is built for: wide enough for the base parameters and every forecast period.
+inline GaussDestrParameters gridDistribution(GaussDestrParameters base, const std::vector<GaussDestrParameters> &gaussVec) {
+    for (const auto &it: gaussVec) {
+        base.mean = std::max(base.mean, it.mean);
+        base.sigma = std::max(base.sigma, it.sigma);
     }
-    return result;
+    return base;
 }
 
-class TaskCalculator {
+// Backward recursion over the periods for a demand policy from demand.h; TaskCalculator
+// is the normal-demand solver. destr and the forecast vector give the mean and standard
+// deviation of each period's demand whatever the policy.
+//
+// precision picks the scalar types (see Precision): Real for the value functions, checkpoints and
+// convolution, Accum for the grid, the expected profit and the argmax scan. y_max, profit_max and
+// the answers are double in every mode.
+template<typename Demand, Precision precision = Precision::full>
+class BasicTaskCalculator {
 public:
-    TaskCalculator(TaskParameters params, GaussDestrParameters destr, int periodsNum, int dotsNum)
-            : m_params(params), m_gauss(destr), totalPeriods(periodsNum), N(dotsNum), y_max(periodsNum-1, destr.mean),
-              x(linspace(-(m_gauss.mean + 3 * m_gauss.sigma), (m_gauss.mean + 3 * m_gauss.sigma), dotsNum)),
-              convolution(m_gauss.mean, m_gauss.sigma, x), integrator(params, destr), profit_max(periodsNum-1, 0.0) {
-        F.resize(totalPeriods);
+    using Real = std::conditional_t<precision == Precision::full, double, float>;
+    using Accum = std::conditional_t<precision == Precision::single, float, double>;
+    using Workspace = BasicFftWorkspace<Real>;
+
+    BasicTaskCalculator(TaskParameters params, GaussDestrParameters destr, int periodsNum, int dotsNum,
+                        PlanRigor rigor = PlanRigor::estimate, FftMode fftMode = FftMode::real,
+                        ValueStorage storage = ValueStorage::full, Demand demand = Demand{})
+            : BasicTaskCalculator(params, destr, periodsNum, std::make_shared<Workspace>(dotsNum, rigor, fftMode),
+                                  storage, std::move(demand)) {
+    }
+
+    // ValueStorage::rolling keeps two value functions instead of one per period, so
+    // memory does not grow with the horizon; use setCheckpoints to retain selected periods.
+    //
+    // All grid-sized buffers come from one arena allocated here; calcPeriod does not allocate, except
+    // that NegativeBinomialDemand grows its tables for a period with a wider demand range than before.
+    BasicTaskCalculator(TaskParameters params, GaussDestrParameters destr, int periodsNum,
+                        std::shared_ptr<Workspace> workspace, ValueStorage storage = ValueStorage::full,
+                        Demand demand = Demand{})
+            : m_params(params), m_gauss(destr), totalPeriods(periodsNum), N(static_cast<int>(workspace->n)),
+              arena(arenaBytes(N, valueFunctionsNum(periodsNum, storage))),
+              y_max(periodsNum-1, destr.mean), profit_max(periodsNum-1, 0.0),
+              convolution(m_gauss.mean, m_gauss.sigma, -(m_gauss.mean + 3 * m_gauss.sigma),
+                          (m_gauss.mean + 3 * m_gauss.sigma), std::move(workspace), demand),
+              integrator(params, destr, demand) {
+        F.resize(valueFunctionsNum(periodsNum, storage));
         for (auto &v: F) {
-            v.resize(N);
+            v = arena.allocate<Real>(N);
         }
-        F[totalPeriods - 1].assign(N, 0.0);
+        x = arena.allocate<Accum>(N);
+        if constexpr (std::is_same_v<Accum, double>) {
+            linspace(-(m_gauss.mean + 3 * m_gauss.sigma), (m_gauss.mean + 3 * m_gauss.sigma), x, N);
+        } else {
+            // Stepped in double, a float running sum would drift off the grid.
+            const auto grid = linspace(-(m_gauss.mean + 3 * m_gauss.sigma), (m_gauss.mean + 3 * m_gauss.sigma),
+                                       static_cast<size_t>(N));
+            std::copy(grid.begin(), grid.end(), x);
+        }
+        x_zero_pos = N / 2;
+        profitTerm = arena.allocate<Accum>(N - x_zero_pos);
+        convolved = arena.allocate<Real>(N / 2);
+        bestValue = arena.allocate<Accum>(N - x_zero_pos);
+        bestIndex = arena.allocate<size_t>(N - x_zero_pos);
+        std::fill(valueFunction(totalPeriods - 1), valueFunction(totalPeriods - 1) + N, Real{0});
         currentPeriod = totalPeriods - 2;
-        x_zero_pos = x.size() / 2;
+        stats.reset(totalPeriods);
+        SOLVE_ALLOC(&stats, Stage::setup, arena.bytes() + 2 * y_max.size() * sizeof(double));
+        convolution.setStats(&stats);
+        integrator.setStats(&stats);
     }
 
-    int getCurrentPeriod() {
+    int getCurrentPeriod() const {
         return currentPeriod;
     }
 
+    // Empty unless built with PURCHASE_FORECAST_INSTRUMENTATION.
+    const SolveStats &getStats() const {
+        return stats;
+    }
+
+    void resetStats() {
+        stats.reset(totalPeriods);
+    }
+
     const std::vector<double> &getMaxY() {
         return y_max;
     }
@@ -130,86 +136,369 @@ public:
     }
 
     std::optional<Answer> getAnswer(double current_x) {
-        if (currentPeriod >= 0 || current_x > x[x.size()-1]) {
-            return std::nullopt;
+        return getAnswers({current_x})[0];
+    }
+
+    // Answers for many starting stocks from one solve. The first-period objective
+    // differs between stocks only by the constant c * current_x over y >= current_x,
+    // so one suffix maximum over the grid serves every query.
+    std::vector<std::optional<Answer>> getAnswers(const std::vector<double> &current_x) {
+        std::vector<std::optional<Answer>> result(current_x.size());
+        if (currentPeriod >= 0) {
+            return result;
         }
-        if (ans) {
-            return ans;
+        buildFirstPeriodPolicy();
+        SOLVE_STAGE(&stats, Stage::answer);
+        const double firstProfit = profit_max.empty() ? 0.0 : profit_max[0];
+        double otherProfit = 0.0;
+        for (const auto &it: getMaxProfit()) {
+            otherProfit += it;
         }
-        if (gaussParamsVector.size() > 0) {
-            convolution.setDistributionParams(gaussParamsVector[0]);
-            integrator.setDistributionParams(gaussParamsVector[0]);
+
+        // A NaN stock has no answer, and would break the ordering the sort needs.
+        std::vector<size_t> order;
+        order.reserve(current_x.size());
+        for (size_t q = 0; q < current_x.size(); ++q) {
+            if (!std::isnan(current_x[q])) {
+                order.push_back(q);
+            }
         }
-        double cur_y_max = -std::numeric_limits<double>::max();
-        auto fft_F = convolution.calculate(F[0]);
-        double maxF = -std::numeric_limits<double>::max();
-        for (int i = x.size() - 1; i >= x_zero_pos; --i) {
-            if(current_x > x[i]){
+        std::sort(order.begin(), order.end(), [&current_x](size_t a, size_t b) {
+            return current_x[a] < current_x[b];
+        });
+        size_t i = x_zero_pos;
+        for (size_t q: order) {
+            const double cur = current_x[q];
+            if (cur > x[N - 1]) {
                 break;
             }
-            double sum_i = -m_params.purchasePrice * (x[i] - current_x)  + integrator.calculate(x[i]) +
-                           m_params.inflation * fft_F[getIndexFromY(x[i])];
-            if (sum_i > maxF) {
-                maxF = sum_i;
-                cur_y_max = x[i];
+            while (x[i] < cur) {
+                ++i;
             }
+            const double maxF = bestValue[i - x_zero_pos] + m_params.purchasePrice * cur;
+            Answer answer{};
+            answer.y = static_cast<double>(x[bestIndex[i - x_zero_pos]]);
+            answer.thisPeriodProfit = maxF - firstProfit;
+            answer.MaxProfit = maxF - firstProfit + otherProfit;
+            result[q] = answer;
         }
-        ans->y = cur_y_max;
-        ans->MaxProfit = maxF - profit_max[0];
-        ans->thisPeriodProfit = maxF - profit_max[0];
-        std::vector<double> res = profit_max;
-        for(int i = res.size()-2;i>=0;--i){
-            res[i] = profit_max[i] - profit_max[i+1];
-        }
-        for(const auto& it : res){
-            ans->MaxProfit +=it;
-        }
-        return ans;
+        return result;
     }
 
     bool calcPeriod() {
         if (currentPeriod < 0) {
             return false;
         }
-        auto &F_current = F[currentPeriod];
-        int n = F_current.size();
+        Real *F_current = valueFunction(currentPeriod);
+        int n = N;
+        stats.period = currentPeriod;
         if(gaussParamsVector.size() > currentPeriod){
             convolution.setDistributionParams(gaussParamsVector[currentPeriod]);
             integrator.setDistributionParams(gaussParamsVector[currentPeriod]);
         }
-        auto fft_F = convolution.calculate(F[currentPeriod + 1]);
-        double maxF = -std::numeric_limits<double>::max();
-        for (int i = n - 1; i >= x_zero_pos; --i) {
-            double sum_i = -m_params.purchasePrice * x[i] + integrator.calculate(x[i]) +
-                           m_params.inflation * fft_F[getIndexFromY(x[i])];
-
-
-            if(sum_i > maxF){
-                maxF = sum_i;
-                y_max[currentPeriod] = x[i];
-            }
-            F_current[i] = maxF;
-            if(y_max[currentPeriod] >= x[i]){
-                F_current[i] += m_params.purchasePrice * x[i];
+        convolution.calculate(valueFunction(currentPeriod + 1), convolved);
+        integrate();
+        SOLVE_STAGE(&stats, Stage::argmax);
+        auto [maxF, arg] = scanMax(x_zero_pos, n, [&](size_t i, Accum maxF, size_t arg) {
+            Accum value = maxF;
+            if(x[arg] >= x[i]){
+                value += purchasePrice() * x[i];
             }
+            F_current[i] = static_cast<Real>(value);
+        });
+        if (maxF > -std::numeric_limits<Accum>::max()) {
+            y_max[currentPeriod] = x[arg];
         }
         profit_max[currentPeriod] = maxF;
         for (int i = x_zero_pos - 1; i >= 0; --i) {
-            F_current[i] = maxF + m_params.purchasePrice * x[i];
+            F_current[i] = static_cast<Real>(maxF + purchasePrice() * x[i]);
+        }
+        auto checkpoint = checkpoints.find(currentPeriod);
+        if (checkpoint != checkpoints.end()) {
+            std::copy(F_current, F_current + N, checkpoint->second.begin());
+        }
+        stats.period = -1;
+        if (settle()) {
+            return true;
         }
         currentPeriod--;
 
         return true;
     }
 
+    // Once the order-up-to level of period k moves by at most policyTolerance and both F[k] - F[k+1]
+    // and F[k+1] - F[k+2] are constant up to valueTolerance, the earlier periods with the same
+    // distribution follow from the stationary policy: the increment shrinks by a fixed ratio (alpha
+    // times the kernel mass the grid keeps), so F[j] = F[j+1] + ratio^(k-j) * (F[k] - F[k+1]).
+    // They are filled in without convolutions and the recursion goes on from the first period whose
+    // distribution differs. Zero tolerances (the default) switch this off.
+    void setConvergence(double policyTolerance_, double valueTolerance_) {
+        policyTolerance = policyTolerance_;
+        valueTolerance = valueTolerance_;
+    }
+
+    // Period at which the recursion settled, or -1; periods after getResumePeriod() and before it
+    // were extrapolated.
+    int getStationaryPeriod() const {
+        return stationaryPeriod;
+    }
+
+    int getResumePeriod() const {
+        return resumePeriod;
+    }
+
+    // Restarts the backward recursion at `period`, keeping the value functions of the later periods.
+    // Only possible with ValueStorage::full; also drops the cached answer.
+    bool rewindTo(int period) {
+        if (F.size() != static_cast<size_t>(totalPeriods)) {
+            return false;
+        }
+        period = std::min(period, totalPeriods - 2);
+        if (period > currentPeriod) {
+            currentPeriod = period;
+            convolution.setDistributionParams(m_gauss);
+            integrator.setDistributionParams(m_gauss);
+            stationaryPeriod = -1;
+            resumePeriod = -1;
+            previousFlat = false;
+        }
+        policyReady = false;
+        return true;
+    }
+
+    // Threads for the grid loops of a period (argmax scan, expected profit, direct convolution);
+    // 1 keeps them serial. Results do not depend on the count. The transforms are threaded by
+    // the workspace (see FftWorkspace).
+    void setThreads(unsigned threads) {
+        team = threads > 1 ? std::make_unique<ThreadTeam>(threads) : nullptr;
+        blockCarry.assign(team ? team->size() * 4 : 0, {});
+        convolution.setThreads(team.get());
+    }
+
+    // See DemandConvolution; the default picks direct or FFT convolution per period.
+    void setConvolutionMethod(ConvolutionMethod method, double kernelSigmas = 8.0) {
+        convolution.setMethod(method, kernelSigmas);
+    }
+
     void setGaussVector(std::vector<GaussDestrParameters> gaussParam){
         gaussParamsVector = std::move(gaussParam);
     }
 
+    // Periods whose value function is copied aside as the recursion passes them.
+    void setCheckpoints(const std::vector<int> &periods) {
+        checkpoints.clear();
+        for (int period: periods) {
+            checkpoints[period].assign(N, 0.0);
+        }
+    }
+
+    // Value function of a period (getGridSize() points), or nullptr when it was not retained.
+    const Real *getValueFunction(int period) const {
+        if (period < 0 || period >= totalPeriods || period <= currentPeriod) {
+            return nullptr;
+        }
+        if (F.size() == static_cast<size_t>(totalPeriods) || period == currentPeriod + 1) {
+            return F[period % F.size()];
+        }
+        auto checkpoint = checkpoints.find(period);
+        return checkpoint != checkpoints.end() ? checkpoint->second.data() : nullptr;
+    }
+
+    int getGridSize() const {
+        return N;
+    }
+
+    // The grid, getGridSize() points.
+    const Accum *getGrid() const {
+        return x;
+    }
+
 private:
+    // bestValue[j] = max over i >= x_zero_pos + j of -c * x[i] + E[profit](x[i]) + alpha * (F * kernel)(x[i]),
+    // the top-most maximiser in bestIndex[j], matching the downward scan with a strict '>'.
+    void buildFirstPeriodPolicy() {
+        if (policyReady) {
+            return;
+        }
+        if (gaussParamsVector.size() > 0) {
+            convolution.setDistributionParams(gaussParamsVector[0]);
+            integrator.setDistributionParams(gaussParamsVector[0]);
+        }
+        convolution.calculate(valueFunction(0), convolved);
+        integrate();
+        SOLVE_STAGE(&stats, Stage::answer);
+        policyReady = true;
+        scanMax(x_zero_pos, N, [&](size_t i, Accum maxF, size_t arg) {
+            bestValue[i - x_zero_pos] = maxF;
+            bestIndex[i - x_zero_pos] = arg;
+        });
+    }
+
+    // E[profit] of the period at every grid point with y >= 0, into profitTerm.
+    void integrate() {
+        if (!team) {
+            integrator.calculate(&x[x_zero_pos], profitTerm, N - x_zero_pos);
+            return;
+        }
+        // The chunks run concurrently, so the stage is timed here rather than by the integrator.
+        SOLVE_STAGE(&stats, Stage::integrator);
+        integrator.setStats(nullptr);
+        forChunks(team.get(), N - x_zero_pos, scanGrain, [&](size_t begin, size_t end) {
+            integrator.calculate(&x[x_zero_pos + begin], profitTerm + begin, end - begin);
+        });
+        integrator.setStats(&stats);
+    }
+
+    // Running maximum of -c * y + E[profit](y) + alpha * convolved(y) over the grid points from
+    // end - 1 down to begin, the top-most maximiser kept as a strict '>' keeps it; visit(i, max, arg)
+    // sees the running state at every point and the final one is returned (arg N - 1 if nothing won).
+    // With a team the range is cut into blocks whose maxima are found in parallel, then carried down
+    // serially from the top block, and the blocks rescanned in parallel from their carry. Every
+    // point gets the same values in the same comparisons as in the serial scan.
+    template<typename Visit>
+    std::pair<Accum, size_t> scanMax(size_t begin, size_t end, const Visit &visit) {
+        const auto alpha = static_cast<Accum>(m_params.inflation);
+        auto scan = [&](size_t from, size_t to, std::pair<Accum, size_t> running, const auto &step) {
+            auto [maxF, arg] = running;
+            for (size_t i = to; i-- > from;) {
+                Accum sum_i = -purchasePrice() * x[i] + profitTerm[i - x_zero_pos] +
+                              alpha * static_cast<Accum>(convolved[getIndexFromY(x[i])]);
+                if (sum_i > maxF) {
+                    maxF = sum_i;
+                    arg = i;
+                }
+                step(i, maxF, arg);
+            }
+            return std::pair<Accum, size_t>{maxF, arg};
+        };
+        const std::pair<Accum, size_t> none{-std::numeric_limits<Accum>::max(), N - 1};
+        const size_t blocks = std::min(blockCarry.size(), (end - begin) / scanGrain);
+        if (!team || blocks < 2) {
+            return scan(begin, end, none, visit);
+        }
+        auto bound = [&](size_t block) {
+            return begin + (end - begin) * block / blocks;
+        };
+        team->run(blocks, [&](size_t block) {
+            blockCarry[block] = scan(bound(block), bound(block + 1), none, [](size_t, Accum, size_t) {});
+        });
+        auto running = none;
+        for (size_t block = blocks; block-- > 0;) {
+            const auto local = blockCarry[block];
+            blockCarry[block] = running;
+            if (local.first > running.first) {
+                running = local;
+            }
+        }
+        team->run(blocks, [&](size_t block) {
+            scan(bound(block), bound(block + 1), blockCarry[block], visit);
+        });
+        return running;
+    }
+
+    Real *valueFunction(int period) {
+        return F[period % F.size()];
+    }
+
+    Accum purchasePrice() const {
+        return static_cast<Accum>(m_params.purchasePrice);
+    }
+
+    GaussDestrParameters periodDistribution(int period) const {
+        return period < static_cast<int>(gaussParamsVector.size()) ? gaussParamsVector[period] : m_gauss;
+    }
+
+    // See setConvergence; called with currentPeriod just computed. Skips the run of earlier
+    // periods that share its distribution and resumes the recursion before it, if any is left.
+    bool settle() {
+        const int k = currentPeriod;
+        if (stationaryPeriod >= 0 || !(policyTolerance > 0.0 || valueTolerance > 0.0) || k + 1 > totalPeriods - 2) {
+            return false;
+        }
+        const Real *F_k = valueFunction(k);
+        const Real *F_next = valueFunction(k + 1);
+        double lo = std::numeric_limits<double>::max();
+        double hi = -std::numeric_limits<double>::max();
+        for (int i = 0; i < N; ++i) {
+            lo = std::min<double>(lo, F_k[i] - F_next[i]);
+            hi = std::max<double>(hi, F_k[i] - F_next[i]);
+        }
+        const bool flat = hi - lo <= valueTolerance && previousFlat;
+        previousFlat = hi - lo <= valueTolerance;
+        if (!flat || k < 1 || k + 2 > totalPeriods - 2 || std::abs(y_max[k] - y_max[k + 1]) > policyTolerance) {
+            return false;
+        }
+        const auto dist = periodDistribution(k);
+        auto sameDistribution = [&](int period) {
+            const auto other = periodDistribution(period);
+            return other.mean == dist.mean && other.sigma == dist.sigma;
+        };
+        int stop = k;
+        while (stop > 0 && sameDistribution(stop - 1)) {
+            --stop;
+        }
+        if (stop == k || !sameDistribution(k + 1) || !sameDistribution(k + 2)) {
+            return false;
+        }
+
+        // shift[j] = F[j] - F[k]; below the zero stock F is maxF + c * x, so the increments are exact there.
+        const double increment = profit_max[k] - profit_max[k + 1];
+        const double previousIncrement = profit_max[k + 1] - profit_max[k + 2];
+        const double ratio = previousIncrement != 0.0 ? increment / previousIncrement : m_params.inflation;
+        std::vector<double> shift(k + 1, 0.0);
+        double step = increment;
+        for (int j = k - 1; j >= stop; --j) {
+            step *= ratio;
+            shift[j] = shift[j + 1] + step;
+            y_max[j] = y_max[k];
+            profit_max[j] = profit_max[k] + shift[j];
+        }
+        for (auto &[period, values]: checkpoints) {
+            if (period >= stop && period < k) {
+                for (int i = 0; i < N; ++i) {
+                    values[i] = static_cast<Real>(F_k[i] + shift[period]);
+                }
+            }
+        }
+        if (F.size() == static_cast<size_t>(totalPeriods)) {
+            for (int j = k - 1; j >= stop; --j) {
+                addShift(valueFunction(j + 1), shift[j] - shift[j + 1], valueFunction(j));
+            }
+        } else {
+            // Rolling storage keeps F[stop] and F[stop + 1]; the one sharing F[k]'s buffer goes last.
+            const bool stopShares = stop % 2 == k % 2;
+            for (int j: {stopShares ? stop + 1 : stop, stopShares ? stop : stop + 1}) {
+                if (j < k) {
+                    addShift(F_k, shift[j], valueFunction(j));
+                }
+            }
+        }
+        stationaryPeriod = k;
+        resumePeriod = stop - 1;
+        currentPeriod = stop - 1;
+        return true;
+    }
+
+    void addShift(const Real *from, double shift, Real *to) const {
+        for (int i = 0; i < N; ++i) {
+            to[i] = static_cast<Real>(from[i] + shift);
+        }
+    }
 
-    int getIndexFromY(double y){
-        return static_cast<int>( y / x[x.size() - 1] * static_cast<double>(x.size() / 2));
+    // The convolution has N / 2 points, so y = x[N - 1] maps to the last of them.
+    int getIndexFromY(Accum y) const {
+        int index = static_cast<int>( y / x[N - 1] * static_cast<double>(N / 2));
+        return std::min(index, N / 2 - 1);
+    }
+
+    static int valueFunctionsNum(int periodsNum, ValueStorage storage) {
+        return storage == ValueStorage::rolling ? std::min(periodsNum, 2) : periodsNum;
+    }
+
+    static size_t arenaBytes(int N, int valueFunctions) {
+        const size_t n = N;
+        return valueFunctions * Arena::bytesFor<Real>(n) + Arena::bytesFor<Accum>(n) + Arena::bytesFor<Accum>(n - n / 2)
+               + Arena::bytesFor<Real>(n / 2) + Arena::bytesFor<Accum>(n - n / 2) + Arena::bytesFor<size_t>(n - n / 2);
     }
 
 
@@ -219,18 +508,37 @@ private:
     int currentPeriod;
     const int totalPeriods;
     const int N;
-    std::vector<std::vector<double>> F;
+    Arena arena;
+    std::vector<Real *> F;
+    std::map<int, std::vector<Real>> checkpoints;
     std::vector<double> y_max;
     std::vector<GaussDestrParameters> gaussParamsVector{};
     std::vector<double> profit_max;
-    std::vector<double> x;
+    Accum *x;
     size_t x_zero_pos;
-    std::optional<Answer> ans{std::nullopt};
+    Accum *profitTerm;
+    Real *convolved;
+    Accum *bestValue;
+    size_t *bestIndex;
+    bool policyReady = false;
+    double policyTolerance = 0.0;
+    double valueTolerance = 0.0;
+    int stationaryPeriod = -1;
+    int resumePeriod = -1;
+    bool previousFlat = false;
+    SolveStats stats;
+    std::unique_ptr<ThreadTeam> team;
+    std::vector<std::pair<Accum, size_t>> blockCarry;
+    static constexpr size_t scanGrain = size_t{1} << 13;
 private:
-    GaussConvolution convolution;
-    ExplicitIntegrator integrator;
+    DemandConvolution<Demand, Real> convolution;
+    typename IntegratorFor<Demand>::type integrator;
 };
 
+using TaskCalculator = BasicTaskCalculator<GaussianDemand>;
+using MixedTaskCalculator = BasicTaskCalculator<GaussianDemand, Precision::mixed>;
+using SingleTaskCalculator = BasicTaskCalculator<GaussianDemand, Precision::single>;
+
 class manager {
 public:
     void process();
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstddef>
+
 struct Answer{
     double y;
     double thisPeriodProfit;
@@ -12,6 +14,47 @@ enum class Period{
     month,
 };
 
+enum class PlanRigor{
+    estimate,
+    measure,
+    patient,
+};
+
+enum class FftMode{
+    complex,
+    real,
+};
+
+enum class ValueStorage{
+    full,
+    rolling,
+};
+
+// Scalar type of the solver (see BasicTaskCalculator). mixed keeps the value functions and their
+// transforms in float and the per-period objective, grid and argmax in double; single is float
+// throughout. Either halves the value function memory. Against full, over grids of 2^10..2^17
+// points and up to 60 periods: y_max within 0.013 sigma or one grid step, whichever is larger (on
+// coarse grids a near tie can tip the argmax to the next point), and the expected profit within
+// 1e-6 relative over 12 periods, 4e-6 over 60; mixed and single alike, float rounding of F is what counts.
+enum class Precision{
+    full,
+    mixed,
+    single,
+};
+
+enum class ConvolutionMethod{
+    automatic,      // per period, whichever the cost model expects to be cheaper
+    fft,
+    direct,         // kernel truncated at kernelSigmas standard deviations
+};
+
+enum class Distribution{
+    gauss,
+    lognormal,
+    negativeBinomial,   // Poisson when the variance does not exceed the mean
+    empirical,          // shape of the history's period totals
+};
+
 struct TaskParameters {
     double profitOfOnePurchase;     // r
     double storageCosts;            // h
@@ -40,6 +83,16 @@ protected:
 class Integrator {
 public:
     virtual double calculate(double y) const = 0;
+    virtual void calculate(const double *y, double *out, size_t count) const {
+        for (size_t i = 0; i < count; ++i) {
+            out[i] = calculate(y[i]);
+        }
+    }
+    virtual void calculate(const float *y, float *out, size_t count) const {
+        for (size_t i = 0; i < count; ++i) {
+            out[i] = static_cast<float>(calculate(static_cast<double>(y[i])));
+        }
+    }
     virtual ~Integrator() {}
 };
 
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "models.h"
+
+#include <chrono>
+#include <cmath>
+#include <ctime>
+#include <utility>
+#include <vector>
+
+// Single-pass aggregation of sales rows into per-period demand parameters.
+// Mean and variance of a period are kept with Welford's update, so no sales are
+// buffered and rows (e.g. newly arrived days) can be appended at any time.
+// The period still being filled is not part of periods().
+class PeriodAggregator {
+public:
+    explicit PeriodAggregator(Period period) : length(std::chrono::hours(periodHours(period))) {
+    }
+
+    void add(time_t date, double y) {
+        auto time = std::chrono::system_clock::from_time_t(date);
+        if (!started) {
+            nextPeriod = time + length;
+            started = true;
+        }
+        if (y == 0.0) {
+            return;
+        }
+        if (time >= nextPeriod) {
+            nextPeriod += length;
+            result.push_back(current());
+            sum = 0.0;
+            count = 0;
+            mean = 0.0;
+            m2 = 0.0;
+        }
+        sum += y;
+        ++count;
+        double delta = y - mean;
+        mean += delta / static_cast<double>(count);
+        m2 += delta * (y - mean);
+    }
+
+    void add(const std::vector<std::pair<time_t, double>> &raw) {
+        for (const auto &[date, y]: raw) {
+            add(date, y);
+        }
+    }
+
+    [[nodiscard]] const std::vector<GaussDestrParameters> &periods() const {
+        return result;
+    }
+
+    // Parameters of the period being filled, as if it were closed now.
+    [[nodiscard]] GaussDestrParameters current() const {
+        double sigma_gauss = sum / 3.0;
+        if (count > 1) {
+            sigma_gauss = std::sqrt(m2 / static_cast<double>(count - 1)) * static_cast<double>(count);
+        }
+        if (sigma_gauss == 0) {
+            sigma_gauss = 1.0;
+        }
+        return {sum, sigma_gauss};
+    }
+
+private:
+    static int periodHours(Period period) {
+        switch (period) {
+            case Period::week:
+                return 24 * 7;
+            case Period::month:
+                return 24 * 30;
+            case Period::day:
+                break;
+        }
+        return 24;
+    }
+
+private:
+    const std::chrono::system_clock::duration length;
+    std::chrono::system_clock::time_point nextPeriod{};
+    bool started = false;
+    double sum = 0.0;
+    size_t count = 0;
+    double mean = 0.0;
+    double m2 = 0.0;
+    std::vector<GaussDestrParameters> result;
+};
+
+// Day, week and month aggregates fed from one pass over the history.
+class HistoryAggregates {
+public:
+    void add(time_t date, double y) {
+        day.add(date, y);
+        week.add(date, y);
+        month.add(date, y);
+    }
+
+    void add(const std::vector<std::pair<time_t, double>> &raw) {
+        for (const auto &[date, y]: raw) {
+            add(date, y);
+        }
+    }
+
+    [[nodiscard]] const PeriodAggregator &get(Period period) const {
+        switch (period) {
+            case Period::week:
+                return week;
+            case Period::month:
+                return month;
+            case Period::day:
+                break;
+        }
+        return day;
+    }
+
+private:
+    PeriodAggregator day{Period::day};
+    PeriodAggregator week{Period::week};
+    PeriodAggregator month{Period::month};
+};
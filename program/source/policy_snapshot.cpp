@@ -0,0 +1,146 @@
+#include "policy_snapshot.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+
+namespace {
+
+const char magic[8] = {'P', 'F', 'P', 'O', 'L', 'I', 'C', 'Y'};
+const uint32_t byteOrderTag = 0x01020304;
+
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;     // byteOrderTag as the writer stored it
+    uint64_t count;
+    uint64_t indexOffset;
+};
+
+struct IndexEntry {
+    uint64_t skuOffset;
+    uint32_t skuLength;
+    uint32_t reserved;
+    uint64_t policyOffset;
+};
+
+static_assert(sizeof(FileHeader) == 32 && sizeof(IndexEntry) == 24 && sizeof(PolicyRecord) == 72,
+              "snapshot records must have no padding");
+
+size_t recordBytes(const PolicyRecord &record) {
+    return sizeof(PolicyRecord)
+           + (2 * size_t{record.periods} + 2 * size_t{record.firstCount} + record.valueCount) * sizeof(double);
+}
+
+}
+
+bool writePolicySnapshots(const std::string &filename, const std::vector<PolicySnapshot> &policies) {
+    std::vector<size_t> order(policies.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&policies](size_t a, size_t b) {
+        return policies[a].sku < policies[b].sku;
+    });
+
+    std::vector<char> buffer(sizeof(FileHeader) + policies.size() * sizeof(IndexEntry));
+    auto append = [&buffer](const void *data, size_t bytes) {
+        buffer.insert(buffer.end(), static_cast<const char *>(data), static_cast<const char *>(data) + bytes);
+    };
+    auto appendArray = [&append](const std::vector<double> &values) {
+        append(values.data(), values.size() * sizeof(double));
+    };
+    std::vector<IndexEntry> index(policies.size());
+    for (size_t k = 0; k < order.size(); ++k) {
+        const auto &policy = policies[order[k]];
+        const auto &p = policy.params;
+        PolicyRecord record{{p.purchasePrice, p.profitOfOnePurchase, p.storageCosts, p.deficitCoefficient,
+                             p.inflation},
+                            policy.gridFront, policy.gridBack, policy.dotsNum,
+                            static_cast<uint32_t>(policy.levels.size()),
+                            static_cast<uint32_t>(policy.firstLevels.size()),
+                            static_cast<uint32_t>(policy.valueFunction.size())};
+        index[k].policyOffset = buffer.size();
+        append(&record, sizeof(record));
+        appendArray(policy.levels);
+        appendArray(policy.periodProfit);
+        appendArray(policy.firstLevels);
+        appendArray(policy.firstValue);
+        appendArray(policy.valueFunction);
+    }
+    for (size_t k = 0; k < order.size(); ++k) {
+        const auto &sku = policies[order[k]].sku;
+        index[k].skuOffset = buffer.size();
+        index[k].skuLength = static_cast<uint32_t>(sku.size());
+        append(sku.data(), sku.size());
+    }
+    FileHeader header{};
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.version = policySnapshotVersion;
+    header.byteOrder = byteOrderTag;
+    header.count = policies.size();
+    header.indexOffset = sizeof(FileHeader);
+    std::memcpy(buffer.data(), &header, sizeof(header));
+    if (!index.empty()) {
+        std::memcpy(buffer.data() + sizeof(FileHeader), index.data(), index.size() * sizeof(IndexEntry));
+    }
+
+    // Written aside and renamed, so a reader never maps a half-written file.
+    const std::string temporary = filename + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        if (!out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()))) {
+            return false;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temporary, filename, error);
+    return !error;
+}
+
+PolicyStore::PolicyStore(const std::string &filename) : file(filename) {
+    const size_t size = file.size();
+    if (!file.isOpen() || size < sizeof(FileHeader)) {
+        return;
+    }
+    const char *base = file.data();
+    FileHeader header{};
+    std::memcpy(&header, base, sizeof(header));
+    if (std::memcmp(header.magic, magic, sizeof(magic)) != 0 || header.version != policySnapshotVersion
+        || header.byteOrder != byteOrderTag || header.indexOffset % 8 != 0 || header.indexOffset > size
+        || header.count > (size - header.indexOffset) / sizeof(IndexEntry)) {
+        return;
+    }
+    policies.reserve(header.count);
+    for (uint64_t k = 0; k < header.count; ++k) {
+        IndexEntry entry{};
+        std::memcpy(&entry, base + header.indexOffset + k * sizeof(IndexEntry), sizeof(entry));
+        if (entry.skuOffset > size || entry.skuLength > size - entry.skuOffset || entry.policyOffset % 8 != 0
+            || entry.policyOffset > size || sizeof(PolicyRecord) > size - entry.policyOffset) {
+            policies.clear();
+            return;
+        }
+        const auto *record = reinterpret_cast<const PolicyRecord *>(base + entry.policyOffset);
+        if (recordBytes(*record) > size - entry.policyOffset
+            || (record->firstCount != 0 && (record->dotsNum < 2 || record->firstCount != record->dotsNum / 2))
+            || (record->valueCount != 0 && record->valueCount != record->dotsNum)) {
+            policies.clear();
+            return;
+        }
+        policies.emplace_back(base + entry.skuOffset, entry.skuLength, record);
+        if (k > 0 && policies[k].sku() < policies[k - 1].sku()) {
+            policies.clear();
+            return;
+        }
+    }
+    valid = true;
+}
+
+PolicyView PolicyStore::find(std::string_view sku) const {
+    auto it = std::lower_bound(policies.begin(), policies.end(), sku, [](const PolicyView &policy, std::string_view key) {
+        return policy.sku() < key;
+    });
+    if (it == policies.end() || it->sku() != sku) {
+        return {};
+    }
+    return *it;
+}
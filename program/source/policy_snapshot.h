@@ -0,0 +1,226 @@
+#pragma once
+
+#include "manager.h"
+#include "sales_reader.h"
+
+#include <cmath>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Solved policy of one product, everything needed to answer orders without the solver.
+struct PolicySnapshot {
+    std::string sku;
+    TaskParameters params;
+    double gridFront;                   // the solver's grid, dotsNum points over [gridFront, gridBack]
+    double gridBack;
+    uint32_t dotsNum;
+    std::vector<double> levels;         // order-up-to level of periods 1, 2, ... (getMaxY)
+    std::vector<double> periodProfit;   // getMaxProfit
+    // First period, for a stock at grid point dotsNum / 2 + j: the level to order up to and the
+    // expected profit over the horizon less c * stock (getAnswers, per grid point).
+    std::vector<double> firstLevels;
+    std::vector<double> firstValue;
+    std::vector<double> valueFunction;  // value function of the first period, dotsNum points, or empty
+};
+
+// Snapshot of a finished solve. The first-period table costs one getAnswers call over half the grid.
+template<typename Calculator>
+PolicySnapshot makeSnapshot(Calculator &calculator, std::string sku, TaskParameters params,
+                            bool withValueFunction = false) {
+    PolicySnapshot snapshot{std::move(sku), params, 0.0, 0.0, 0, {}, {}, {}, {}, {}};
+    const int n = calculator.getGridSize();
+    const auto *x = calculator.getGrid();
+    snapshot.gridFront = x[0];
+    snapshot.gridBack = x[n - 1];
+    snapshot.dotsNum = static_cast<uint32_t>(n);
+    snapshot.levels = calculator.getMaxY();
+    snapshot.periodProfit = calculator.getMaxProfit();
+    const std::vector<double> stocks(x + n / 2, x + n);
+    const auto answers = calculator.getAnswers(stocks);
+    for (size_t j = 0; j < stocks.size(); ++j) {
+        if (!answers[j]) {
+            snapshot.firstLevels.clear();
+            snapshot.firstValue.clear();
+            break;
+        }
+        snapshot.firstLevels.push_back(answers[j]->y);
+        snapshot.firstValue.push_back(answers[j]->MaxProfit - params.purchasePrice * stocks[j]);
+    }
+    const auto *F = withValueFunction ? calculator.getValueFunction(0) : nullptr;
+    if (F) {
+        snapshot.valueFunction.assign(F, F + n);
+    }
+    return snapshot;
+}
+
+// Snapshot file, version policySnapshotVersion, in the writer's native byte order; the reader
+// rejects a file whose byte order tag reads differently, so files do not move between byte orders:
+//   header     magic "PFPOLICY", version, byte order tag, policy count, offset of the index
+//   index      per policy, sorted by SKU: SKU offset and length, policy offset
+//   policies   per policy a PolicyRecord followed by levels, periodProfit, firstLevels, firstValue
+//              and valueFunction; every array starts 8-aligned
+//   SKUs       the SKU strings, not terminated
+constexpr uint32_t policySnapshotVersion = 1;
+
+// Returns false if the file can't be written. SKUs should be unique; find returns any one of duplicates.
+bool writePolicySnapshots(const std::string &filename, const std::vector<PolicySnapshot> &policies);
+
+struct PolicyRecord {
+    double params[5];                   // c, r, h, p, alpha
+    double gridFront;
+    double gridBack;
+    uint32_t dotsNum;
+    uint32_t periods;                   // size of levels and periodProfit
+    uint32_t firstCount;                // size of firstLevels and firstValue, dotsNum / 2 or 0
+    uint32_t valueCount;                // size of valueFunction, dotsNum or 0
+};
+
+// One policy inside a mapped snapshot file, valid while its PolicyStore lives.
+// Periods count from 0, the first; every lookup is O(1).
+class PolicyView {
+public:
+    PolicyView() = default;
+
+    PolicyView(const char *sku, uint32_t skuLength, const PolicyRecord *record_)
+            : name(sku, skuLength), record(record_) {
+        const auto *data = reinterpret_cast<const double *>(record + 1);
+        levelsData = data;
+        profitData = levelsData + record->periods;
+        firstLevelsData = profitData + record->periods;
+        firstValueData = firstLevelsData + record->firstCount;
+        valueData = record->valueCount ? firstValueData + record->firstCount : nullptr;
+    }
+
+    [[nodiscard]] bool isValid() const {
+        return record != nullptr;
+    }
+
+    [[nodiscard]] std::string_view sku() const {
+        return name;
+    }
+
+    [[nodiscard]] TaskParameters params() const {
+        return {record->params[1], record->params[2], record->params[4], record->params[3], record->params[0]};
+    }
+
+    // Decisions covered: the first period and one per level.
+    [[nodiscard]] size_t periods() const {
+        return record->periods + 1;
+    }
+
+    // Level the stock is raised to in period: the first period's as solved for this stock (nullopt
+    // above gridBack, as getAnswer); later ones the period's order-up-to level, or the stock
+    // itself when it is already above. A stock within rounding of a grid point may take the answer
+    // of the neighbouring point.
+    [[nodiscard]] std::optional<double> orderUpTo(size_t period, double stock) const {
+        if (period == 0) {
+            const auto j = firstIndex(stock);
+            if (!j) {
+                return std::nullopt;
+            }
+            return firstLevelsData[*j];
+        }
+        if (period > record->periods) {
+            return std::nullopt;
+        }
+        return std::max(levelsData[period - 1], stock);
+    }
+
+    [[nodiscard]] std::optional<double> order(size_t period, double stock) const {
+        const auto level = orderUpTo(period, stock);
+        if (!level) {
+            return std::nullopt;
+        }
+        return std::max(*level - stock, 0.0);
+    }
+
+    // Expected profit over the whole horizon when the first period starts with stock (Answer::MaxProfit).
+    [[nodiscard]] std::optional<double> expectedProfit(double stock) const {
+        const auto j = firstIndex(stock);
+        if (!j) {
+            return std::nullopt;
+        }
+        return firstValueData[*j] + record->params[0] * stock;
+    }
+
+    [[nodiscard]] const double *levels() const {
+        return levelsData;
+    }
+
+    [[nodiscard]] const double *periodProfit() const {
+        return profitData;
+    }
+
+    // First-period value function over the grid (gridSize() points), or nullptr when not stored.
+    [[nodiscard]] const double *valueFunction() const {
+        return valueData;
+    }
+
+    [[nodiscard]] size_t gridSize() const {
+        return record->dotsNum;
+    }
+
+    [[nodiscard]] double gridFront() const {
+        return record->gridFront;
+    }
+
+    [[nodiscard]] double gridBack() const {
+        return record->gridBack;
+    }
+
+private:
+    // The first-period row for stock: the first grid point at or above it, counted from the middle.
+    [[nodiscard]] std::optional<size_t> firstIndex(double stock) const {
+        if (record->firstCount == 0 || !(stock <= record->gridBack)) {
+            return std::nullopt;
+        }
+        const size_t half = record->dotsNum / 2;
+        const double step = (record->gridBack - record->gridFront) / (record->dotsNum - 1);
+        const double index = std::ceil((stock - record->gridFront) / step);
+        const double i = std::clamp(index, static_cast<double>(half), static_cast<double>(record->dotsNum - 1));
+        return static_cast<size_t>(i) - half;
+    }
+
+private:
+    std::string_view name;
+    const PolicyRecord *record = nullptr;
+    const double *levelsData = nullptr;
+    const double *profitData = nullptr;
+    const double *firstLevelsData = nullptr;
+    const double *firstValueData = nullptr;
+    const double *valueData = nullptr;
+};
+
+// Memory-mapped snapshot file. Opening checks the header and every index entry once, so the
+// lookups do not; only the pages of the policies actually read are loaded.
+class PolicyStore {
+public:
+    explicit PolicyStore(const std::string &filename);
+
+    PolicyStore(const PolicyStore &) = delete;
+    PolicyStore &operator=(const PolicyStore &) = delete;
+
+    // False if the file is missing, of another version or byte order, or damaged.
+    [[nodiscard]] bool isOpen() const {
+        return valid;
+    }
+
+    [[nodiscard]] size_t size() const {
+        return policies.size();
+    }
+
+    [[nodiscard]] const PolicyView &operator[](size_t index) const {
+        return policies[index];
+    }
+
+    // Binary search over the sorted SKUs; an invalid view if absent.
+    [[nodiscard]] PolicyView find(std::string_view sku) const;
+
+private:
+    MappedFile file;
+    std::vector<PolicyView> policies;
+    bool valid = false;
+};
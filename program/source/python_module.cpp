@@ -0,0 +1,284 @@
+// purchase_forecast: the solver core as a Python extension module (PURCHASE_FORECAST_PYTHON).
+//
+// Arrays cross without copies where the layout allows: sales histories and forecasts are read
+// straight from the caller's float64 buffers (the forecast then fills the calculator's own
+// per-period vector), getGrid returns a read-only view of the calculator's grid that keeps it
+// alive, and computed results hand their vectors to NumPy. getMaxY and getValueFunction copy, as
+// a solve running in another thread may be writing them.
+// Solves run with the GIL released, so Python threads can each drive their own calculator in parallel.
+//
+//   import purchase_forecast as pf
+//   forecast = pf.parsePeriods(dates, sales, pf.Period.week)
+//   calculator = pf.TaskCalculator(pf.TaskParameters(30, 50, 2, 10, 0.97), mean=100, sigma=20, periodsNum=12)
+//   calculator.setGaussVector(forecast)
+//   calculator.solve()
+//   level, periodProfit, totalProfit = calculator.getAnswer(40)
+
+#include "manager.h"
+#include "period_aggregator.h"
+
+#include <pybind11/numpy.h>
+#include <pybind11/pybind11.h>
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+namespace py = pybind11;
+
+namespace {
+
+using DoubleArray = py::array_t<double, py::array::c_style | py::array::forcecast>;
+using DateArray = py::array_t<int64_t, py::array::c_style | py::array::forcecast>;
+
+static_assert(sizeof(GaussDestrParameters) == 2 * sizeof(double), "a forecast is viewed as (periods, 2) doubles");
+
+// TaskCalculator and a lock. Every method that touches the solve holds the lock, so a calculator
+// can be shared between Python threads; the lock is taken with the GIL released, so a thread
+// waiting for it does not block the others.
+struct PyTaskCalculator {
+    PyTaskCalculator(TaskParameters params, GaussDestrParameters destr, int periodsNum, int dotsNum,
+                     PlanRigor rigor, FftMode fftMode, ValueStorage storage)
+            : calculator(params, destr, periodsNum, dotsNum, rigor, fftMode, storage) {
+    }
+
+    std::mutex mutex;
+    TaskCalculator calculator;
+};
+
+template<typename Body>
+auto withoutGil(PyTaskCalculator &self, const Body &body) {
+    py::gil_scoped_release release;
+    std::lock_guard<std::mutex> lock(self.mutex);
+    return body(self.calculator);
+}
+
+// A read-only array over memory owned by base.
+py::array_t<double> view(const double *data, py::ssize_t size, py::handle base) {
+    py::array_t<double> result({size}, data, base);
+    result.attr("setflags")(py::arg("write") = false);
+    return result;
+}
+
+// The array takes the vector over, without copying its elements.
+py::array_t<double> adopt(std::vector<double> &&values) {
+    auto *owned = new std::vector<double>(std::move(values));
+    py::capsule base(owned, [](void *ptr) {
+        delete static_cast<std::vector<double> *>(ptr);
+    });
+    return py::array_t<double>({static_cast<py::ssize_t>(owned->size())}, owned->data(), base);
+}
+
+py::array_t<double> adopt(std::vector<GaussDestrParameters> &&values) {
+    auto *owned = new std::vector<GaussDestrParameters>(std::move(values));
+    py::capsule base(owned, [](void *ptr) {
+        delete static_cast<std::vector<GaussDestrParameters> *>(ptr);
+    });
+    return py::array_t<double>({static_cast<py::ssize_t>(owned->size()), py::ssize_t{2}},
+                               reinterpret_cast<const double *>(owned->data()), base);
+}
+
+// (periods, 2) means and sigmas, as parsePeriods returns them.
+std::vector<GaussDestrParameters> toForecast(const DoubleArray &gauss) {
+    if (gauss.ndim() != 2 || gauss.shape(1) != 2) {
+        throw py::value_error("forecast must have shape (periods, 2): mean, sigma");
+    }
+    std::vector<GaussDestrParameters> result(static_cast<size_t>(gauss.shape(0)));
+    for (size_t i = 0; i < result.size(); ++i) {
+        result[i] = {gauss.data()[2 * i], gauss.data()[2 * i + 1]};
+    }
+    return result;
+}
+
+std::vector<GaussDestrParameters> toForecast(const DoubleArray &means, const DoubleArray &sigmas) {
+    if (means.ndim() != 1 || sigmas.ndim() != 1 || means.shape(0) != sigmas.shape(0)) {
+        throw py::value_error("means and sigmas must be 1-d arrays of one length");
+    }
+    std::vector<GaussDestrParameters> result(static_cast<size_t>(means.shape(0)));
+    for (size_t i = 0; i < result.size(); ++i) {
+        result[i] = {means.data()[i], sigmas.data()[i]};
+    }
+    return result;
+}
+
+// Same aggregation as parsePeriods, fed from the arrays instead of a copy of the rows.
+py::array_t<double> parsePeriodsOf(const DateArray &dates, const DoubleArray &sales, Period period) {
+    if (dates.ndim() != 1 || sales.ndim() != 1 || dates.shape(0) != sales.shape(0)) {
+        throw py::value_error("dates and sales must be 1-d arrays of one length");
+    }
+    const int64_t *date = dates.data();
+    const double *y = sales.data();
+    const auto rows = dates.shape(0);
+    std::vector<GaussDestrParameters> periods;
+    {
+        py::gil_scoped_release release;
+        PeriodAggregator aggregator(period);
+        for (py::ssize_t i = 0; i < rows; ++i) {
+            aggregator.add(static_cast<time_t>(date[i]), y[i]);
+        }
+        periods = aggregator.periods();
+    }
+    return adopt(std::move(periods));
+}
+
+py::object toPython(const std::optional<Answer> &answer) {
+    if (!answer) {
+        return py::none();
+    }
+    return py::make_tuple(answer->y, answer->thisPeriodProfit, answer->MaxProfit);
+}
+
+}
+
+PYBIND11_MODULE(purchase_forecast, m) {
+    m.doc() = "Purchase Forecast solver core: the multi-period order optimisation of TaskCalculator.";
+
+    py::enum_<Period>(m, "Period")
+            .value("day", Period::day)
+            .value("week", Period::week)
+            .value("month", Period::month);
+    py::enum_<PlanRigor>(m, "PlanRigor")
+            .value("estimate", PlanRigor::estimate)
+            .value("measure", PlanRigor::measure)
+            .value("patient", PlanRigor::patient);
+    py::enum_<FftMode>(m, "FftMode")
+            .value("complex", FftMode::complex)
+            .value("real", FftMode::real);
+    py::enum_<ValueStorage>(m, "ValueStorage")
+            .value("full", ValueStorage::full)
+            .value("rolling", ValueStorage::rolling);
+
+    py::class_<TaskParameters>(m, "TaskParameters",
+                               "Costs of one product. inflation is alpha, the share of value kept per period "
+                               "(the CLI's 1 - inflation / 100).")
+            .def(py::init([](double purchasePrice, double profitOfOnePurchase, double storageCosts,
+                             double deficitCoefficient, double inflation) {
+                return TaskParameters{profitOfOnePurchase, storageCosts, inflation, deficitCoefficient, purchasePrice};
+            }), py::arg("purchasePrice"), py::arg("profitOfOnePurchase"), py::arg("storageCosts"),
+                 py::arg("deficitCoefficient"), py::arg("inflation"))
+            .def_readwrite("purchasePrice", &TaskParameters::purchasePrice)
+            .def_readwrite("profitOfOnePurchase", &TaskParameters::profitOfOnePurchase)
+            .def_readwrite("storageCosts", &TaskParameters::storageCosts)
+            .def_readwrite("deficitCoefficient", &TaskParameters::deficitCoefficient)
+            .def_readwrite("inflation", &TaskParameters::inflation);
+
+    m.def("parsePeriods", &parsePeriodsOf, py::arg("dates"), py::arg("sales"), py::arg("period") = Period::day,
+          "Per-period demand of a sales history, as a (periods, 2) array of mean and sigma.\n"
+          "dates are seconds since the epoch (int64), sales the amount sold; rows in date order.\n"
+          "The last, unfinished period is left out, as in the Purchase Forecast file reader.");
+
+    py::class_<PyTaskCalculator>(m, "TaskCalculator",
+                                 "Backward recursion over the periods for normal demand (BasicTaskCalculator).\n"
+                                 "The grid spans [-(mean + 3 sigma), mean + 3 sigma] in dotsNum points.")
+            .def(py::init([](TaskParameters params, double mean, double sigma, int periodsNum, int dotsNum,
+                             PlanRigor rigor, FftMode fftMode, ValueStorage storage) {
+                if (!(sigma > 0.0) || periodsNum < 1 || dotsNum < 4) {
+                    throw py::value_error("sigma must be positive, periodsNum at least 1 and dotsNum at least 4");
+                }
+                py::gil_scoped_release release;
+                return new PyTaskCalculator(params, {mean, sigma}, periodsNum, dotsNum, rigor, fftMode, storage);
+            }), py::arg("params"), py::arg("mean"), py::arg("sigma"), py::arg("periodsNum"),
+                 py::arg("dotsNum") = 1 << 10, py::arg("rigor") = PlanRigor::estimate,
+                 py::arg("fftMode") = FftMode::real, py::arg("storage") = ValueStorage::full)
+            .def("setGaussVector", [](PyTaskCalculator &self, const DoubleArray &gauss) {
+                auto forecast = toForecast(gauss);
+                withoutGil(self, [&forecast](TaskCalculator &calculator) {
+                    calculator.setGaussVector(std::move(forecast));
+                });
+            }, py::arg("forecast"), "Per-period mean and sigma, a (periods, 2) array such as parsePeriods returns.")
+            .def("setGaussVector", [](PyTaskCalculator &self, const DoubleArray &means, const DoubleArray &sigmas) {
+                auto forecast = toForecast(means, sigmas);
+                withoutGil(self, [&forecast](TaskCalculator &calculator) {
+                    calculator.setGaussVector(std::move(forecast));
+                });
+            }, py::arg("means"), py::arg("sigmas"))
+            .def("setConvergence", [](PyTaskCalculator &self, double policyTolerance, double valueTolerance) {
+                withoutGil(self, [&](TaskCalculator &calculator) {
+                    calculator.setConvergence(policyTolerance, valueTolerance);
+                });
+            }, py::arg("policyTolerance"), py::arg("valueTolerance"))
+            .def("setThreads", [](PyTaskCalculator &self, unsigned threads) {
+                withoutGil(self, [threads](TaskCalculator &calculator) {
+                    calculator.setThreads(threads);
+                });
+            }, py::arg("threads"))
+            .def("calcPeriod", [](PyTaskCalculator &self) {
+                return withoutGil(self, [](TaskCalculator &calculator) {
+                    return calculator.calcPeriod();
+                });
+            }, "One period of the recursion; False once every period is done.")
+            .def("solve", [](PyTaskCalculator &self) {
+                withoutGil(self, [](TaskCalculator &calculator) {
+                    while (calculator.calcPeriod()) {
+                    }
+                });
+            }, "All remaining periods.")
+            .def("getCurrentPeriod", [](PyTaskCalculator &self) {
+                return withoutGil(self, [](TaskCalculator &calculator) {
+                    return calculator.getCurrentPeriod();
+                });
+            })
+            .def("getStationaryPeriod", [](PyTaskCalculator &self) {
+                return withoutGil(self, [](TaskCalculator &calculator) {
+                    return calculator.getStationaryPeriod();
+                });
+            })
+            .def("getMaxY", [](PyTaskCalculator &self) {
+                return adopt(withoutGil(self, [](TaskCalculator &calculator) {
+                    return calculator.getMaxY();
+                }));
+            }, "Order-up-to level of periods 2, 3, ...")
+            .def("getMaxProfit", [](PyTaskCalculator &self) {
+                return adopt(withoutGil(self, [](TaskCalculator &calculator) {
+                    return calculator.getMaxProfit();
+                }));
+            }, "Expected profit of periods 2, 3, ... alone.")
+            .def("getGrid", [](py::object self) {
+                // Written once by the constructor, so the view needs no lock.
+                const auto &calculator = self.cast<PyTaskCalculator &>().calculator;
+                return view(calculator.getGrid(), calculator.getGridSize(), self);
+            }, "The grid; a read-only view of the calculator's memory.")
+            .def("getValueFunction", [](PyTaskCalculator &self, int period) -> py::object {
+                auto F = withoutGil(self, [period](TaskCalculator &calculator) -> std::optional<std::vector<double>> {
+                    const double *values = calculator.getValueFunction(period);
+                    if (!values) {
+                        return std::nullopt;
+                    }
+                    return std::vector<double>(values, values + calculator.getGridSize());
+                });
+                if (!F) {
+                    return py::none();
+                }
+                return adopt(std::move(*F));
+            }, py::arg("period"),
+                 "Value function of a period over getGrid(), or None when not retained (with\n"
+                 "ValueStorage.rolling only the last two periods solved are).")
+            .def("getAnswer", [](PyTaskCalculator &self, double stock) {
+                return toPython(withoutGil(self, [stock](TaskCalculator &calculator) {
+                    return calculator.getAnswer(stock);
+                }));
+            }, py::arg("stock"),
+                 "(order-up-to level, first period profit, total profit) for a starting stock, or None.")
+            .def("getAnswers", [](PyTaskCalculator &self, const DoubleArray &stocks) {
+                if (stocks.ndim() != 1) {
+                    throw py::value_error("stocks must be a 1-d array");
+                }
+                std::vector<double> levels(stocks.data(), stocks.data() + stocks.shape(0));
+                auto answers = withoutGil(self, [&levels](TaskCalculator &calculator) {
+                    return calculator.getAnswers(levels);
+                });
+                std::vector<double> y(answers.size()), period(answers.size()), total(answers.size());
+                for (size_t i = 0; i < answers.size(); ++i) {
+                    const double none = std::numeric_limits<double>::quiet_NaN();
+                    y[i] = answers[i] ? answers[i]->y : none;
+                    period[i] = answers[i] ? answers[i]->thisPeriodProfit : none;
+                    total[i] = answers[i] ? answers[i]->MaxProfit : none;
+                }
+                return py::make_tuple(adopt(std::move(y)), adopt(std::move(period)), adopt(std::move(total)));
+            }, py::arg("stocks"),
+                 "getAnswer for many stocks from one solve: arrays of level, first period and total\n"
+                 "profit, NaN where there is no answer.");
+}
@@ -0,0 +1,228 @@
+#include "sales_reader.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string &filename) {
+    file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                       FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        file = nullptr;
+        return;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) {
+        return;
+    }
+    length = static_cast<size_t>(size.QuadPart);
+    opened = true;
+    if (length == 0) {
+        return;
+    }
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping) {
+        begin = static_cast<const char *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    }
+    opened = begin != nullptr;
+}
+
+MappedFile::~MappedFile() {
+    if (begin) {
+        UnmapViewOfFile(begin);
+    }
+    if (mapping) {
+        CloseHandle(mapping);
+    }
+    if (file) {
+        CloseHandle(file);
+    }
+}
+
+#else
+
+MappedFile::MappedFile(const std::string &filename) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+    struct stat st{};
+    if (fstat(fd, &st) == 0) {
+        length = static_cast<size_t>(st.st_size);
+        opened = true;
+        if (length > 0) {
+            void *ptr = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (ptr == MAP_FAILED) {
+                opened = false;
+            } else {
+                begin = static_cast<const char *>(ptr);
+                madvise(ptr, length, MADV_SEQUENTIAL);
+            }
+        }
+    }
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (begin) {
+        munmap(const_cast<char *>(begin), length);
+    }
+}
+
+#endif
+
+namespace {
+
+bool isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+bool readDigits(const char *&p, const char *last, int minCount, int maxCount, int &value) {
+    value = 0;
+    int count = 0;
+    for (; count < maxCount && p != last && *p >= '0' && *p <= '9'; ++count, ++p) {
+        value = value * 10 + (*p - '0');
+    }
+    return count >= minCount;
+}
+
+bool readNumber(const char *&p, const char *last, double &value) {
+    static const double pow10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                   1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18};
+    const char *start = p;
+    bool negative = false;
+    if (p != last && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        ++p;
+    }
+    unsigned long long mantissa = 0;
+    int digits = 0;
+    int fraction = 0;
+    bool point = false;
+    for (; p != last; ++p) {
+        if (*p >= '0' && *p <= '9') {
+            mantissa = mantissa * 10 + (*p - '0');
+            ++digits;
+            fraction += point;
+        } else if ((*p == '.' || *p == ',') && !point) {
+            point = true;
+        } else {
+            break;
+        }
+    }
+    if (digits == 0) {
+        return false;
+    }
+    if (digits <= 15) {
+        // Both operands are exact doubles, so the quotient is correctly rounded.
+        value = static_cast<double>(mantissa) / pow10[fraction];
+    } else {
+        std::string text(start, p);
+        std::replace(text.begin(), text.end(), ',', '.');
+        value = std::strtod(text.c_str(), nullptr);
+        return true;
+    }
+    value = negative ? -value : value;
+    return true;
+}
+
+}
+
+bool parseSalesLine(const char *first, const char *last, time_t &date, double &value) {
+    static const int monthDays[] = {31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    const char *p = first;
+    while (p != last && isBlank(*p)) {
+        ++p;
+    }
+    int day, month, year;
+    if (!readDigits(p, last, 1, 2, day) || p == last || *p++ != '.'
+        || !readDigits(p, last, 1, 2, month) || p == last || *p++ != '.'
+        || !readDigits(p, last, 4, 4, year)) {
+        return false;
+    }
+    if (month < 1 || month > 12 || day < 1 || day > monthDays[month - 1]) {
+        return false;
+    }
+    if (month == 2 && day == 29 && !(year % 4 == 0 && (year % 100 != 0 || year % 400 == 0))) {
+        return false;
+    }
+    if (p == last || !isBlank(*p)) {
+        return false;
+    }
+    while (p != last && isBlank(*p)) {
+        ++p;
+    }
+    if (!readNumber(p, last, value)) {
+        return false;
+    }
+    while (p != last && isBlank(*p)) {
+        ++p;
+    }
+    if (p != last) {
+        return false;
+    }
+    date = static_cast<time_t>(epochDays(year, month, day) * 86400);
+    return true;
+}
+
+size_t readSalesFile(const std::string &filename, const std::function<void(time_t, double)> &onRow,
+                     std::vector<MalformedLine> *errors) {
+    MappedFile file(filename);
+    if (!file.isOpen() || file.size() == 0) {
+        return 0;
+    }
+    const char *p = file.data();
+    const char *end = p + file.size();
+    const char *eol = static_cast<const char *>(std::memchr(p, '\n', end - p));
+    const char *headerEnd = eol ? eol : end;
+    static const char header[] = "Purchase Forecast file";
+    if (std::search(p, headerEnd, header, header + sizeof(header) - 1) == headerEnd) {
+        return 0;
+    }
+
+    size_t rows = 0;
+    size_t line = 1;
+    p = eol ? eol + 1 : end;
+    while (p < end) {
+        ++line;
+        eol = static_cast<const char *>(std::memchr(p, '\n', end - p));
+        const char *lineEnd = eol ? eol : end;
+        time_t date;
+        double value;
+        if (parseSalesLine(p, lineEnd, date, value)) {
+            onRow(date, value);
+            ++rows;
+        } else {
+            const char *q = p;
+            while (q != lineEnd && isBlank(*q)) {
+                ++q;
+            }
+            if (q != lineEnd && errors) {
+                errors->push_back({line, std::string(p, lineEnd)});
+            }
+        }
+        p = lineEnd + 1;
+    }
+    return rows;
+}
+
+std::vector<std::pair<time_t, double>> readSalesFile(const std::string &filename, std::vector<MalformedLine> *errors) {
+    std::vector<std::pair<time_t, double>> result;
+    readSalesFile(filename, [&result](time_t date, double value) {
+        result.emplace_back(date, value);
+    }, errors);
+    return result;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <ctime>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Read-only view of a whole file. The pages are mapped lazily by the OS, so the
+// file may be larger than RAM.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string &filename);
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    [[nodiscard]] bool isOpen() const {
+        return opened;
+    }
+
+    [[nodiscard]] const char *data() const {
+        return begin;
+    }
+
+    [[nodiscard]] size_t size() const {
+        return length;
+    }
+
+private:
+    const char *begin = nullptr;
+    size_t length = 0;
+    bool opened = false;
+#ifdef _WIN32
+    void *file = nullptr;
+    void *mapping = nullptr;
+#endif
+};
+
+struct MalformedLine {
+    size_t line;        // 1-based, the header is line 1
+    std::string text;
+};
+
+// Days since 1970-01-01 of a proleptic Gregorian date, no time zone involved.
+constexpr long long epochDays(int year, int month, int day) {
+    year -= month <= 2;
+    const long long era = (year >= 0 ? year : year - 399) / 400;
+    const long long yoe = year - era * 400;
+    const long long doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    const long long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+// Parses "dd.mm.yyyy value" (value with '.' or ',' as decimal separator). Returns false on malformed input.
+bool parseSalesLine(const char *first, const char *last, time_t &date, double &value);
+
+// Memory-mapped reader of a "Purchase Forecast file". Dates become UTC midnights.
+// Malformed lines are skipped and, if errors is given, reported there.
+// onRow is called for every row in file order and no rows are kept, so the file may be larger than RAM.
+// Returns the number of rows read; 0 if the file can't be opened or is not a Purchase Forecast file.
+size_t readSalesFile(const std::string &filename, const std::function<void(time_t, double)> &onRow,
+                     std::vector<MalformedLine> *errors = nullptr);
+
+// All rows of the file at once.
+std::vector<std::pair<time_t, double>> readSalesFile(const std::string &filename,
+                                                     std::vector<MalformedLine> *errors = nullptr);
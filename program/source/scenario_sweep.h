@@ -0,0 +1,216 @@
+#pragma once
+
+#include "manager.h"
+
+#include <memory>
+#include <optional>
+#include <vector>
+
+// Every TaskParameters in scenarios run through the backward recursion together, for one demand
+// forecast and grid. Per period the kernel is built once and the value functions of all scenarios
+// are convolved as one batch of transforms; the rest of the period (expected profit, argmax) is
+// per scenario, spread over the threads given to setThreads. Each scenario ends up with the
+// y_max, profit and answers a rolling-storage BasicTaskCalculator would give it. scenarios must
+// not be empty.
+//
+// threads is also what the batch and the kernel transform are planned for (see BasicFftWorkspace);
+// pass the same count to setThreads.
+template<typename Demand>
+class BasicScenarioSweep {
+public:
+    BasicScenarioSweep(std::vector<TaskParameters> scenarios_, GaussDestrParameters destr, int periodsNum,
+                       int dotsNum, PlanRigor rigor = PlanRigor::estimate, FftMode fftMode = FftMode::real,
+                       unsigned threads = 1, Demand demand = Demand{})
+            : scenarios(std::move(scenarios_)), m_gauss(destr), totalPeriods(periodsNum), N(dotsNum),
+              S(scenarios.size()), half(static_cast<size_t>(N) / 2),
+              arena(2 * Arena::bytesFor<double>(S * N) + Arena::bytesFor<double>(N)
+                    + 2 * Arena::bytesFor<double>(S * half)),
+              batch(N, S, rigor, fftMode, threads),
+              y_max(S, std::vector<double>(periodsNum - 1, destr.mean)),
+              profit_max(S, std::vector<double>(periodsNum - 1, 0.0)),
+              convolution(m_gauss.mean, m_gauss.sigma, -(m_gauss.mean + 3 * m_gauss.sigma),
+                          (m_gauss.mean + 3 * m_gauss.sigma), std::make_shared<FftWorkspace>(N, rigor, fftMode, threads),
+                          demand) {
+        for (auto &it: F) {
+            it = arena.allocate<double>(S * N);
+        }
+        x = arena.allocate<double>(N);
+        linspace(-(m_gauss.mean + 3 * m_gauss.sigma), (m_gauss.mean + 3 * m_gauss.sigma), x, N);
+        convolved = arena.allocate<double>(S * half);
+        profitTerm = arena.allocate<double>(S * half);
+        integrators.reserve(S);
+        for (const auto &it: scenarios) {
+            integrators.emplace_back(it, destr, demand);
+        }
+        std::fill(valueFunctions(totalPeriods - 1), valueFunctions(totalPeriods - 1) + S * N, 0.0);
+        currentPeriod = totalPeriods - 2;
+    }
+
+    BasicScenarioSweep(const BasicScenarioSweep &) = delete;
+    BasicScenarioSweep &operator=(const BasicScenarioSweep &) = delete;
+
+    void setGaussVector(std::vector<GaussDestrParameters> gaussParam) {
+        gaussParamsVector = std::move(gaussParam);
+    }
+
+    // See BasicTaskCalculator::setThreads; here the scenarios are spread over the threads.
+    void setThreads(unsigned threads) {
+        team = threads > 1 ? std::make_unique<ThreadTeam>(threads) : nullptr;
+        convolution.setThreads(team.get());
+    }
+
+    // See DemandConvolution.
+    void setConvolutionMethod(ConvolutionMethod method, double kernelSigmas = 8.0) {
+        convolution.setMethod(method, kernelSigmas);
+    }
+
+    // Advances every scenario by one period; false once the recursion is complete.
+    bool calcPeriod() {
+        if (currentPeriod < 0) {
+            return false;
+        }
+        setPeriodDistribution(currentPeriod);
+        convolution.calculateBatch(valueFunctions(currentPeriod + 1), convolved, S, batch);
+        forChunks(team.get(), S, 1, [&](size_t begin, size_t end) {
+            for (size_t k = begin; k < end; ++k) {
+                double *F_current = valueFunctions(currentPeriod) + k * N;
+                const double c = scenarios[k].purchasePrice;
+                auto [maxF, arg] = scan(k, half);
+                for (size_t i = 0; i < half; ++i) {
+                    F_current[i] = maxF + c * x[i];
+                }
+                if (maxF > -std::numeric_limits<double>::max()) {
+                    y_max[k][currentPeriod] = x[arg];
+                }
+                profit_max[k][currentPeriod] = maxF;
+            }
+        });
+        currentPeriod--;
+        return true;
+    }
+
+    [[nodiscard]] size_t getScenarioCount() const {
+        return S;
+    }
+
+    [[nodiscard]] int getCurrentPeriod() const {
+        return currentPeriod;
+    }
+
+    [[nodiscard]] const TaskParameters &getScenario(size_t scenario) const {
+        return scenarios[scenario];
+    }
+
+    [[nodiscard]] const std::vector<double> &getMaxY(size_t scenario) const {
+        return y_max[scenario];
+    }
+
+    // Profit of each period alone, as BasicTaskCalculator::getMaxProfit.
+    [[nodiscard]] std::vector<double> getMaxProfit(size_t scenario) const {
+        std::vector<double> res = profit_max[scenario];
+        for (int i = static_cast<int>(res.size()) - 2; i >= 0; --i) {
+            res[i] = profit_max[scenario][i] - profit_max[scenario][i + 1];
+        }
+        return res;
+    }
+
+    // The first-period answer of every scenario for the starting stock current_x, once the recursion is done.
+    std::vector<std::optional<Answer>> getAnswers(double current_x) {
+        std::vector<std::optional<Answer>> result(S);
+        if (currentPeriod >= 0 || current_x > x[N - 1]) {
+            return result;
+        }
+        setPeriodDistribution(0);
+        convolution.calculateBatch(valueFunctions(0), convolved, S, batch);
+        size_t first = half;
+        while (x[first] < current_x) {
+            ++first;
+        }
+        forChunks(team.get(), S, 1, [&](size_t begin, size_t end) {
+            for (size_t k = begin; k < end; ++k) {
+                auto [maxF, arg] = scan(k, first);
+                maxF += scenarios[k].purchasePrice * current_x;
+                const double firstProfit = profit_max[k].empty() ? 0.0 : profit_max[k][0];
+                double otherProfit = 0.0;
+                for (const auto &it: getMaxProfit(k)) {
+                    otherProfit += it;
+                }
+                Answer answer{};
+                answer.y = x[arg];
+                answer.thisPeriodProfit = maxF - firstProfit;
+                answer.MaxProfit = maxF - firstProfit + otherProfit;
+                result[k] = answer;
+            }
+        });
+        return result;
+    }
+
+private:
+    // Running maximum of scenario k's objective over the grid points from N - 1 down to from, as
+    // BasicTaskCalculator::scanMax; fills F of the current period above from on the way.
+    std::pair<double, size_t> scan(size_t k, size_t from) {
+        const TaskParameters &params = scenarios[k];
+        double *term = profitTerm + k * half;
+        const double *conv = convolved + k * half;
+        integrators[k].calculate(&x[half], term, N - half);
+        double *F_current = currentPeriod >= 0 ? valueFunctions(currentPeriod) + k * N : nullptr;
+        double maxF = -std::numeric_limits<double>::max();
+        size_t arg = N - 1;
+        for (size_t i = N; i-- > from;) {
+            double sum_i = -params.purchasePrice * x[i] + term[i - half] +
+                           params.inflation * conv[getIndexFromY(x[i])];
+            if (sum_i > maxF) {
+                maxF = sum_i;
+                arg = i;
+            }
+            if (F_current) {
+                F_current[i] = maxF;
+                if (x[arg] >= x[i]) {
+                    F_current[i] += params.purchasePrice * x[i];
+                }
+            }
+        }
+        return {maxF, arg};
+    }
+
+    void setPeriodDistribution(int period) {
+        if (gaussParamsVector.size() > static_cast<size_t>(period)) {
+            convolution.setDistributionParams(gaussParamsVector[period]);
+            for (auto &it: integrators) {
+                it.setDistributionParams(gaussParamsVector[period]);
+            }
+        }
+    }
+
+    double *valueFunctions(int period) {
+        return F[period % 2];
+    }
+
+    int getIndexFromY(double y) const {
+        int index = static_cast<int>(y / x[N - 1] * static_cast<double>(N / 2));
+        return std::min(index, N / 2 - 1);
+    }
+
+private:
+    const std::vector<TaskParameters> scenarios;
+    const GaussDestrParameters m_gauss;
+    const int totalPeriods;
+    const int N;
+    const size_t S;
+    const size_t half;
+    int currentPeriod;
+    Arena arena;
+    BatchFftWorkspace batch;
+    double *F[2];
+    double *x;
+    double *convolved;
+    double *profitTerm;
+    std::vector<GaussDestrParameters> gaussParamsVector{};
+    std::vector<std::vector<double>> y_max;
+    std::vector<std::vector<double>> profit_max;
+    std::unique_ptr<ThreadTeam> team;
+    DemandConvolution<Demand> convolution;
+    std::vector<typename IntegratorFor<Demand>::type> integrators;
+};
+
+using ScenarioSweep = BasicScenarioSweep<GaussianDemand>;
@@ -0,0 +1,190 @@
+#include "simulation.h"
+#include "work_stealing_pool.h"
+
+#include <cmath>
+
+namespace {
+
+struct Outcome {
+    double profit = 0.0;
+    double revenue = 0.0;
+    double purchaseCost = 0.0;
+    double holdingCost = 0.0;
+    double deficitCost = 0.0;
+    double shortage = 0.0;
+    uint64_t stockouts = 0;
+};
+
+// Sums of a block of scenarios; profit variance by Welford's update, blocks merged with Chan's formula.
+struct Accumulator {
+    void add(const Outcome &it) {
+        ++count;
+        double delta = it.profit - mean;
+        mean += delta / static_cast<double>(count);
+        m2 += delta * (it.profit - mean);
+        sums.revenue += it.revenue;
+        sums.purchaseCost += it.purchaseCost;
+        sums.holdingCost += it.holdingCost;
+        sums.deficitCost += it.deficitCost;
+        sums.shortage += it.shortage;
+        sums.stockouts += it.stockouts;
+    }
+
+    void merge(const Accumulator &other) {
+        if (other.count == 0) {
+            return;
+        }
+        const double total = static_cast<double>(count + other.count);
+        const double delta = other.mean - mean;
+        m2 += other.m2 + delta * delta * static_cast<double>(count) * static_cast<double>(other.count) / total;
+        mean += delta * static_cast<double>(other.count) / total;
+        count += other.count;
+        sums.revenue += other.sums.revenue;
+        sums.purchaseCost += other.sums.purchaseCost;
+        sums.holdingCost += other.sums.holdingCost;
+        sums.deficitCost += other.sums.deficitCost;
+        sums.shortage += other.sums.shortage;
+        sums.stockouts += other.sums.stockouts;
+    }
+
+    uint64_t count = 0;
+    double mean = 0.0;
+    double m2 = 0.0;
+    Outcome sums;
+};
+
+template<typename Demand>
+Outcome simulatePath(const SimulationPolicy &policy, const TaskParameters &params, double startStock, Demand demand) {
+    const double r = params.profitOfOnePurchase;
+    const double alpha = params.inflation;
+    Outcome res;
+    double x = startStock;
+    double discount = 1.0;
+    for (size_t j = 0; j < policy.levels.size(); ++j) {
+        const double y = std::max(x, policy.levels[j]);
+        const double D = demand(j);
+        res.purchaseCost += discount * params.purchasePrice * (y - x);
+        if (D <= y) {
+            res.revenue += discount * r * D;
+            res.holdingCost += discount * params.storageCosts * (y - D);
+        } else {
+            res.revenue += discount * (r * y + alpha * r * (D - y));
+            res.deficitCost += discount * params.deficitCoefficient * (D - y);
+            res.shortage += D - y;
+            ++res.stockouts;
+        }
+        x = y - D;
+        discount *= alpha;
+    }
+    res.profit = res.revenue - res.purchaseCost - res.holdingCost - res.deficitCost;
+    return res;
+}
+
+// Runs path(index) for every index in [0, count) in blocks, reducing the blocks in order.
+template<typename Path>
+SimulationSummary run(size_t periods, uint64_t count, unsigned threads, Path path) {
+    const uint64_t block = 4096;
+    std::vector<Accumulator> blocks((count + block - 1) / block);
+    WorkStealingPool pool(threads);
+    pool.run(blocks.size(), [&](size_t index, unsigned) {
+        const uint64_t end = std::min(count, (index + 1) * block);
+        for (uint64_t i = index * block; i < end; ++i) {
+            blocks[index].add(path(i));
+        }
+    });
+    Accumulator total;
+    for (const auto &it: blocks) {
+        total.merge(it);
+    }
+    SimulationSummary summary;
+    summary.scenarios = total.count;
+    summary.periods = periods;
+    if (total.count == 0) {
+        return summary;
+    }
+    const double n = static_cast<double>(total.count);
+    summary.profit = total.mean;
+    summary.profitStdDev = total.count > 1 ? std::sqrt(total.m2 / (n - 1.0)) : 0.0;
+    summary.revenue = total.sums.revenue / n;
+    summary.purchaseCost = total.sums.purchaseCost / n;
+    summary.holdingCost = total.sums.holdingCost / n;
+    summary.deficitCost = total.sums.deficitCost / n;
+    summary.shortage = total.sums.shortage / n;
+    summary.stockoutRate = periods ? static_cast<double>(total.sums.stockouts) / (n * static_cast<double>(periods)) : 0.0;
+    return summary;
+}
+
+// Uniform in (0, 1) from 64 random bits.
+double uniform(uint32_t hi, uint32_t lo) {
+    const uint64_t bits = (uint64_t{hi} << 32 | lo) >> 11;
+    return (static_cast<double>(bits) + 0.5) * 0x1.0p-53;
+}
+
+// Box-Muller pairs from counter (scenario, period, attempt), rejecting negative demand.
+double truncatedGauss(const Philox4x32 &rng, uint64_t scenario, uint32_t period, GaussDestrParameters gauss) {
+    for (uint32_t attempt = 0; attempt < 1024; ++attempt) {
+        auto bits = rng({static_cast<uint32_t>(scenario), static_cast<uint32_t>(scenario >> 32), period, attempt});
+        const double radius = std::sqrt(-2.0 * std::log(uniform(bits[0], bits[1])));
+        const double angle = 2.0 * M_PI * uniform(bits[2], bits[3]);
+        const double first = gauss.mean + gauss.sigma * radius * std::cos(angle);
+        if (first >= 0.0) {
+            return first;
+        }
+        const double second = gauss.mean + gauss.sigma * radius * std::sin(angle);
+        if (second >= 0.0) {
+            return second;
+        }
+    }
+    return 0.0;
+}
+
+}
+
+SimulationPolicy makePolicy(const Answer &first, const std::vector<double> &y_max, GaussDestrParameters base,
+                            const std::vector<GaussDestrParameters> &gaussVec) {
+    SimulationPolicy policy;
+    auto gaussAt = [&](size_t k) {
+        return k < gaussVec.size() ? gaussVec[k] : base;
+    };
+    policy.levels.push_back(first.y);
+    policy.demand.push_back(gaussAt(0));
+    for (size_t k = 0; k < y_max.size(); ++k) {
+        policy.levels.push_back(y_max[k]);
+        policy.demand.push_back(gaussAt(k));
+    }
+    return policy;
+}
+
+SimulationSummary simulateGaussian(const SimulationPolicy &policy, TaskParameters params, double startStock,
+                                   uint64_t scenarios, uint64_t seed, unsigned threads) {
+    const Philox4x32 rng(seed);
+    return run(policy.levels.size(), scenarios, threads, [&](uint64_t scenario) {
+        return simulatePath(policy, params, startStock, [&](size_t j) {
+            return truncatedGauss(rng, scenario, static_cast<uint32_t>(j), policy.demand[j]);
+        });
+    });
+}
+
+SimulationSummary simulateHistory(const SimulationPolicy &policy, TaskParameters params, double startStock,
+                                  const std::vector<double> &demand, unsigned threads) {
+    const size_t periods = policy.levels.size();
+    const uint64_t windows = demand.size() >= periods && periods > 0 ? demand.size() - periods + 1 : 0;
+    return run(periods, windows, threads, [&](uint64_t start) {
+        return simulatePath(policy, params, startStock, [&](size_t j) {
+            return demand[start + j];
+        });
+    });
+}
+
+void writeSummary(std::ostream &out, const SimulationSummary &summary) {
+    out << "scenarios\t" << summary.scenarios << "\n";
+    out << "periods\t" << summary.periods << "\n";
+    out << "profit\t" << summary.profit << "\n";
+    out << "profit_stddev\t" << summary.profitStdDev << "\n";
+    out << "revenue\t" << summary.revenue << "\n";
+    out << "purchase_cost\t" << summary.purchaseCost << "\n";
+    out << "holding_cost\t" << summary.holdingCost << "\n";
+    out << "deficit_cost\t" << summary.deficitCost << "\n";
+    out << "stockout_rate\t" << summary.stockoutRate << "\n";
+    out << "shortage\t" << summary.shortage << "\n";
+}
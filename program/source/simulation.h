@@ -0,0 +1,74 @@
+#pragma once
+
+#include "manager.h"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+// Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3").
+// The output is a pure function of (key, counter), so every scenario draws from
+// its own stream and results do not depend on the number of threads.
+class Philox4x32 {
+public:
+    using Counter = std::array<uint32_t, 4>;
+
+    explicit Philox4x32(uint64_t seed) : key{static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32)} {
+    }
+
+    [[nodiscard]] Counter operator()(Counter counter) const {
+        std::array<uint32_t, 2> k = key;
+        for (int round = 0; round < 10; ++round) {
+            const uint64_t p0 = uint64_t{0xD2511F53} * counter[0];
+            const uint64_t p1 = uint64_t{0xCD9E8D57} * counter[2];
+            counter = {static_cast<uint32_t>(p1 >> 32) ^ counter[1] ^ k[0], static_cast<uint32_t>(p1),
+                       static_cast<uint32_t>(p0 >> 32) ^ counter[3] ^ k[1], static_cast<uint32_t>(p0)};
+            k[0] += 0x9E3779B9;
+            k[1] += 0xBB67AE85;
+        }
+        return counter;
+    }
+
+private:
+    std::array<uint32_t, 2> key;
+};
+
+// Order-up-to policy: at the start of period j the stock is raised to levels[j] if it is below it.
+// demand[j] is the distribution period j was solved for.
+struct SimulationPolicy {
+    std::vector<double> levels;
+    std::vector<GaussDestrParameters> demand;
+};
+
+// Levels of a finished solve: the answer for the starting stock followed by getMaxY(). The calculator
+// uses gaussVec[0] for the first two decisions and gaussVec[k] for y_max[k]; base stands in for
+// periods gaussVec does not cover (the distribution the calculator was constructed with).
+SimulationPolicy makePolicy(const Answer &first, const std::vector<double> &y_max, GaussDestrParameters base,
+                            const std::vector<GaussDestrParameters> &gaussVec);
+
+// Means over scenarios, discounted by inflation^j like the solver's objective, so that
+// profit = revenue - purchaseCost - holdingCost - deficitCost. Unmet demand is backordered:
+// it is penalised with p, paid for next period (r * inflation) and carried as negative stock.
+struct SimulationSummary {
+    uint64_t scenarios = 0;
+    size_t periods = 0;
+    double profit = 0.0;
+    double profitStdDev = 0.0;
+    double revenue = 0.0;
+    double purchaseCost = 0.0;
+    double holdingCost = 0.0;
+    double deficitCost = 0.0;
+    double stockoutRate = 0.0;     // share of periods whose demand exceeded the stock after ordering
+    double shortage = 0.0;         // backordered units per scenario, undiscounted
+};
+
+// Demand of period j is drawn from demand[j] truncated at zero, as in ExplicitIntegrator.
+SimulationSummary simulateGaussian(const SimulationPolicy &policy, TaskParameters params, double startStock,
+                                   uint64_t scenarios, uint64_t seed = 0, unsigned threads = 0);
+
+// Replays the policy over every window of policy.levels.size() consecutive periods of the history.
+// demand holds the sales of each period, e.g. the means of parsePeriods (which are period totals).
+SimulationSummary simulateHistory(const SimulationPolicy &policy, TaskParameters params, double startStock,
+                                  const std::vector<double> &demand, unsigned threads = 0);
+
+void writeSummary(std::ostream &out, const SimulationSummary &summary);
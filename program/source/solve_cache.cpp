@@ -0,0 +1,358 @@
+#include "solve_cache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+namespace {
+
+const char entryMagic[8] = {'P', 'F', 'C', 'A', 'C', 'H', 'E', '1'};
+const char *entryExtension = ".pfcache";
+
+class ByteWriter {
+public:
+    template<typename T>
+    void put(T value) {
+        bytes.append(reinterpret_cast<const char *>(&value), sizeof(value));
+    }
+
+    void put(const std::vector<double> &values) {
+        put(static_cast<uint64_t>(values.size()));
+        bytes.append(reinterpret_cast<const char *>(values.data()), values.size() * sizeof(double));
+    }
+
+    void put(const std::optional<Answer> &answer) {
+        put(static_cast<uint8_t>(answer.has_value()));
+        const Answer value = answer.value_or(Answer{});
+        put(value.y);
+        put(value.thisPeriodProfit);
+        put(value.MaxProfit);
+    }
+
+    std::string bytes;
+};
+
+// Reads what ByteWriter wrote; any read past the end leaves ok false.
+class ByteReader {
+public:
+    explicit ByteReader(const std::string &bytes_) : bytes(bytes_) {
+    }
+
+    template<typename T>
+    T get() {
+        T value{};
+        if (bytes.size() - position < sizeof(T)) {
+            ok = false;
+            return value;
+        }
+        std::memcpy(&value, bytes.data() + position, sizeof(T));
+        position += sizeof(T);
+        return value;
+    }
+
+    std::vector<double> getVector() {
+        const auto size = get<uint64_t>();
+        if (!ok || size > (bytes.size() - position) / sizeof(double)) {
+            ok = false;
+            return {};
+        }
+        std::vector<double> values(size);
+        std::memcpy(values.data(), bytes.data() + position, size * sizeof(double));
+        position += size * sizeof(double);
+        return values;
+    }
+
+    std::optional<Answer> getAnswer() {
+        const bool has = get<uint8_t>() != 0;
+        Answer value{};
+        value.y = get<double>();
+        value.thisPeriodProfit = get<double>();
+        value.MaxProfit = get<double>();
+        return has ? std::optional<Answer>(value) : std::nullopt;
+    }
+
+    [[nodiscard]] bool done() const {
+        return ok && position == bytes.size();
+    }
+
+    [[nodiscard]] size_t remaining() const {
+        return bytes.size() - position;
+    }
+
+private:
+    const std::string &bytes;
+    size_t position = 0;
+    bool ok = true;
+};
+
+std::string encode(const ProductResult &result) {
+    ByteWriter out;
+    out.put(result.y_max);
+    out.put(result.profit_max);
+    out.put(result.answer);
+    out.put(result.order);
+    out.put(static_cast<uint64_t>(result.stockAnswers.size()));
+    for (const auto &it: result.stockAnswers) {
+        out.put(it);
+    }
+    out.put(static_cast<int32_t>(result.stationaryPeriod));
+    out.put(static_cast<int32_t>(result.grid.dotsNum));
+    out.put(result.grid.goodsError);
+    out.put(result.grid.moneyError);
+    out.put(static_cast<int32_t>(result.grid.solves));
+    out.put(static_cast<uint8_t>(result.grid.met));
+    return std::move(out.bytes);
+}
+
+std::optional<ProductResult> decode(const std::string &bytes, const std::string &sku) {
+    ByteReader in(bytes);
+    ProductResult result(sku);
+    result.y_max = in.getVector();
+    result.profit_max = in.getVector();
+    result.answer = in.getAnswer();
+    result.order = in.get<double>();
+    const auto stocks = in.get<uint64_t>();
+    if (stocks > in.remaining() / (1 + 3 * sizeof(double))) {
+        return std::nullopt;
+    }
+    for (uint64_t k = 0; k < stocks; ++k) {
+        result.stockAnswers.push_back(in.getAnswer());
+    }
+    result.stationaryPeriod = in.get<int32_t>();
+    result.grid.dotsNum = in.get<int32_t>();
+    result.grid.goodsError = in.get<double>();
+    result.grid.moneyError = in.get<double>();
+    result.grid.solves = in.get<int32_t>();
+    result.grid.met = in.get<uint8_t>() != 0;
+    if (!in.done()) {
+        return std::nullopt;
+    }
+    return result;
+}
+
+// FNV-1a, 64 bits.
+uint64_t hashKey(const std::string &key) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (unsigned char c: key) {
+        hash = (hash ^ c) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+}
+
+std::string solveCacheKey(const Product &product, int periodsNum, int dotsNum, FftMode fftMode,
+                          const SolveOptions &options) {
+    ByteWriter key;
+    key.put(solverVersion);
+    key.put(static_cast<int32_t>(periodsNum));
+    key.put(static_cast<int32_t>(dotsNum));
+    key.put(static_cast<int32_t>(fftMode));
+    key.put(static_cast<int32_t>(options.precision));
+    key.put(static_cast<int32_t>(product.distribution));
+    const auto &p = product.params;
+    for (double value: {p.purchasePrice, p.profitOfOnePurchase, p.storageCosts, p.deficitCoefficient, p.inflation,
+                        product.gauss.mean, product.gauss.sigma}) {
+        key.put(value);
+    }
+    key.put(static_cast<uint64_t>(product.gaussVec.size()));
+    for (const auto &it: product.gaussVec) {
+        key.put(it.mean);
+        key.put(it.sigma);
+    }
+    key.put(product.currentStock);
+    key.put(product.stockLevels);
+    key.put(options.convergence);
+    key.put(options.grid.goods);
+    key.put(options.grid.money);
+    key.put(static_cast<int32_t>(options.grid.minDots));
+    key.put(static_cast<int32_t>(options.grid.maxDots));
+    return std::move(key.bytes);
+}
+
+void writeCacheStats(std::ostream &out, const CacheStats &stats) {
+    out << "cache_hits\t" << stats.memoryHits + stats.diskHits << "\n";
+    out << "cache_memory_hits\t" << stats.memoryHits << "\n";
+    out << "cache_disk_hits\t" << stats.diskHits << "\n";
+    out << "cache_misses\t" << stats.misses << "\n";
+    out << "cache_hit_rate\t" << stats.hitRate() << "\n";
+    out << "cache_memory_bytes\t" << stats.memoryBytes << "\t" << stats.memoryEntries << " entries\n";
+    out << "cache_disk_bytes\t" << stats.diskBytes << "\t" << stats.diskEntries << " entries\n";
+}
+
+SolveCache::SolveCache(size_t memoryLimit_, std::string directory_, size_t diskLimit_)
+        : memoryLimit(memoryLimit_), directory(std::move(directory_)), diskLimit(diskLimit_) {
+    if (directory.empty()) {
+        return;
+    }
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    for (std::filesystem::directory_iterator it(directory, error), end; !error && it != end; it.increment(error)) {
+        std::error_code entryError;
+        if (it->path().extension() != entryExtension || !it->is_regular_file(entryError)) {
+            continue;
+        }
+        const auto bytes = static_cast<size_t>(it->file_size(entryError));
+        const auto used = it->last_write_time(entryError);
+        if (!entryError) {
+            disk[it->path().filename().string()] = DiskEntry{bytes, used};
+            stats.diskBytes += bytes;
+        }
+    }
+    evictFromDisk();
+}
+
+std::optional<ProductResult> SolveCache::find(const std::string &key) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = memory.find(key);
+    if (it != memory.end()) {
+        recent.splice(recent.begin(), recent, it->second);
+        auto result = decode(it->second->value, {});
+        if (result) {
+            ++stats.memoryHits;
+            return result;
+        }
+    }
+    if (!directory.empty()) {
+        if (auto value = readFromDisk(key)) {
+            auto result = decode(*value, {});
+            if (result) {
+                ++stats.diskHits;
+                storeInMemory(key, std::move(*value));
+                return result;
+            }
+        }
+    }
+    ++stats.misses;
+    return std::nullopt;
+}
+
+void SolveCache::store(const std::string &key, const ProductResult &result) {
+    std::string value = encode(result);
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!directory.empty()) {
+        storeOnDisk(key, value);
+    }
+    storeInMemory(key, std::move(value));
+}
+
+CacheStats SolveCache::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+void SolveCache::storeInMemory(const std::string &key, std::string value) {
+    auto it = memory.find(key);
+    if (it != memory.end()) {
+        stats.memoryBytes -= it->second->key.size() + it->second->value.size();
+        recent.erase(it->second);
+        memory.erase(it);
+    }
+    const size_t bytes = key.size() + value.size();
+    if (bytes <= memoryLimit) {
+        recent.push_front(MemoryEntry{key, std::move(value)});
+        memory[key] = recent.begin();
+        stats.memoryBytes += bytes;
+    }
+    while (stats.memoryBytes > memoryLimit) {
+        const auto &last = recent.back();
+        stats.memoryBytes -= last.key.size() + last.value.size();
+        memory.erase(last.key);
+        recent.pop_back();
+    }
+    stats.memoryEntries = memory.size();
+}
+
+// An entry file: entryMagic, the key's length and bytes, then the encoded result.
+void SolveCache::storeOnDisk(const std::string &key, const std::string &value) {
+    const auto path = entryPath(key);
+    const auto temporary = path.string() + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        const auto keyLength = static_cast<uint64_t>(key.size());
+        out.write(entryMagic, sizeof(entryMagic));
+        out.write(reinterpret_cast<const char *>(&keyLength), sizeof(keyLength));
+        out << key << value;
+        if (!out) {
+            return;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temporary, path, error);
+    if (error) {
+        std::filesystem::remove(temporary, error);
+        return;
+    }
+    const auto name = path.filename().string();
+    auto old = disk.find(name);
+    if (old != disk.end()) {
+        stats.diskBytes -= old->second.bytes;
+    }
+    const size_t bytes = sizeof(entryMagic) + sizeof(uint64_t) + key.size() + value.size();
+    disk[name] = DiskEntry{bytes, std::filesystem::file_time_type::clock::now()};
+    stats.diskBytes += bytes;
+    evictFromDisk();
+}
+
+void SolveCache::evictFromDisk() {
+    if (stats.diskBytes > diskLimit) {
+        std::vector<std::map<std::string, DiskEntry>::iterator> byUse;
+        for (auto it = disk.begin(); it != disk.end(); ++it) {
+            byUse.push_back(it);
+        }
+        std::sort(byUse.begin(), byUse.end(), [](const auto &a, const auto &b) {
+            return a->second.used < b->second.used;
+        });
+        std::error_code error;
+        for (auto it: byUse) {
+            if (stats.diskBytes <= diskLimit) {
+                break;
+            }
+            std::filesystem::remove(directory / it->first, error);
+            stats.diskBytes -= it->second.bytes;
+            disk.erase(it);
+        }
+    }
+    stats.diskEntries = disk.size();
+}
+
+std::optional<std::string> SolveCache::readFromDisk(const std::string &key) {
+    const auto path = entryPath(key);
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) {
+        return std::nullopt;
+    }
+    const std::string content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    uint64_t keyLength = 0;
+    const size_t header = sizeof(entryMagic) + sizeof(keyLength);
+    if (content.size() >= header) {
+        std::memcpy(&keyLength, content.data() + sizeof(entryMagic), sizeof(keyLength));
+    }
+    if (content.size() < header || std::memcmp(content.data(), entryMagic, sizeof(entryMagic)) != 0
+        || keyLength != key.size() || content.compare(header, key.size(), key) != 0) {
+        return std::nullopt;
+    }
+    // Touched, so eviction here and in other processes sees it as recently used.
+    std::error_code error;
+    const auto now = std::filesystem::file_time_type::clock::now();
+    std::filesystem::last_write_time(path, now, error);
+    const auto name = path.filename().string();
+    auto it = disk.find(name);
+    if (it == disk.end()) {
+        disk[name] = DiskEntry{content.size(), now};
+        stats.diskBytes += content.size();
+        stats.diskEntries = disk.size();
+    } else {
+        it->second.used = now;
+    }
+    return content.substr(header + key.size());
+}
+
+std::filesystem::path SolveCache::entryPath(const std::string &key) const {
+    char name[17];
+    std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(hashKey(key)));
+    return directory / (std::string(name) + entryExtension);
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "batch.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+// Bump whenever a solver change alters results, so older cache entries are no longer found.
+constexpr uint32_t solverVersion = 1;
+
+// Everything solveProduct's result depends on, as canonical bytes: the product (parameters,
+// distributions, stocks), the horizon, the grid, FFT mode and precision, the convergence and grid
+// options and solverVersion. Plan rigor and thread counts are left out; they change round-off at most.
+std::string solveCacheKey(const Product &product, int periodsNum, int dotsNum, FftMode fftMode,
+                          const SolveOptions &options);
+
+struct CacheStats {
+    uint64_t memoryHits = 0;
+    uint64_t diskHits = 0;
+    uint64_t misses = 0;
+    size_t memoryBytes = 0;
+    size_t memoryEntries = 0;
+    size_t diskBytes = 0;
+    size_t diskEntries = 0;
+
+    [[nodiscard]] double hitRate() const {
+        const uint64_t lookups = memoryHits + diskHits + misses;
+        return lookups ? static_cast<double>(memoryHits + diskHits) / static_cast<double>(lookups) : 0.0;
+    }
+};
+
+void writeCacheStats(std::ostream &out, const CacheStats &stats);
+
+// Results of finished solves by solveCacheKey: an in-memory tier and, if a directory is given, an
+// on-disk tier of one file per entry named by the key's hash. Both are least recently used first
+// out once over their byte limit. A hit compares the whole key, so hash collisions only cost a miss.
+// Entries hold y_max, profit_max, the answers, order, stationaryPeriod and grid; stats and policy
+// are not kept. Safe to use from several threads; several processes may share the directory,
+// each accounting only for the files it has seen.
+class SolveCache {
+public:
+    explicit SolveCache(size_t memoryLimit = size_t{64} << 20, std::string directory = {},
+                        size_t diskLimit = size_t{1} << 30);
+
+    SolveCache(const SolveCache &) = delete;
+    SolveCache &operator=(const SolveCache &) = delete;
+
+    std::optional<ProductResult> find(const std::string &key);
+
+    void store(const std::string &key, const ProductResult &result);
+
+    [[nodiscard]] CacheStats getStats() const;
+
+private:
+    struct MemoryEntry {
+        std::string key;
+        std::string value;
+    };
+
+    struct DiskEntry {
+        size_t bytes;
+        std::filesystem::file_time_type used;
+    };
+
+    void storeInMemory(const std::string &key, std::string value);
+    void storeOnDisk(const std::string &key, const std::string &value);
+    void evictFromDisk();
+    std::optional<std::string> readFromDisk(const std::string &key);
+    [[nodiscard]] std::filesystem::path entryPath(const std::string &key) const;
+
+private:
+    const size_t memoryLimit;
+    const std::filesystem::path directory;
+    const size_t diskLimit;
+    mutable std::mutex mutex;
+    std::list<MemoryEntry> recent;      // most recently used first
+    std::unordered_map<std::string, std::list<MemoryEntry>::iterator> memory;
+    std::map<std::string, DiskEntry> disk;      // by file name
+    CacheStats stats;
+};
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "manager.h"
+
+#include <functional>
+#include <memory>
+
+// Keeps the calculator of the last solve alive. When only the forecast changes, the
+// backward recursion restarts at the latest changed period and the value functions
+// of the periods after it are reused; any other change triggers a full solve.
+class SolverSession {
+public:
+    // threads: see BasicTaskCalculator::setThreads and FftWorkspace.
+    explicit SolverSession(PlanRigor rigor = PlanRigor::estimate, FftMode fftMode = FftMode::real, unsigned threads = 1)
+            : m_rigor(rigor), m_fftMode(fftMode), m_threads(threads) {
+    }
+
+    // Returns the number of periods that had to be (re)computed. onPeriod gets the running count
+    // after every period and may return false to stop; the next solve then picks up where this one stopped.
+    int solve(TaskParameters params, GaussDestrParameters destr, int periodsNum, int dotsNum,
+              std::vector<GaussDestrParameters> gaussVec, const std::function<bool(int)> &onPeriod = {}) {
+        auto grid = gridDistribution(destr, gaussVec);
+        bool reuse = calculator && sameParams(params, m_params) && sameGauss(grid, m_grid)
+                     && periodsNum == m_periodsNum && dotsNum == m_dotsNum;
+        if (reuse) {
+            int changed = -1;
+            for (int i = periodsNum - 2; i >= 0 && changed < 0; --i) {
+                if (!sameGauss(periodGauss(m_gaussVec, i), periodGauss(gaussVec, i))) {
+                    changed = i;
+                }
+            }
+            calculator->rewindTo(changed);
+            calculator->resetStats();
+        } else {
+            calculator = std::make_unique<TaskCalculator>(
+                    params, grid, periodsNum, std::make_shared<FftWorkspace>(dotsNum, m_rigor, m_fftMode, m_threads));
+            calculator->setThreads(m_threads);
+        }
+        m_params = params;
+        m_grid = grid;
+        m_periodsNum = periodsNum;
+        m_dotsNum = dotsNum;
+        m_gaussVec = gaussVec;
+        calculator->setGaussVector(std::move(gaussVec));
+
+        int recomputed = 0;
+        while (calculator->calcPeriod()) {
+            ++recomputed;
+            if (onPeriod && !onPeriod(recomputed)) {
+                break;
+            }
+        }
+        return recomputed;
+    }
+
+    TaskCalculator *getCalculator() {
+        return calculator.get();
+    }
+
+    [[nodiscard]] bool isComplete() const {
+        return calculator && calculator->getCurrentPeriod() < 0;
+    }
+
+    void reset() {
+        calculator.reset();
+    }
+
+private:
+    GaussDestrParameters periodGauss(const std::vector<GaussDestrParameters> &gaussVec, int period) const {
+        return period < static_cast<int>(gaussVec.size()) ? gaussVec[period] : m_grid;
+    }
+
+    static bool sameGauss(GaussDestrParameters a, GaussDestrParameters b) {
+        return a.mean == b.mean && a.sigma == b.sigma;
+    }
+
+    static bool sameParams(TaskParameters a, TaskParameters b) {
+        return a.profitOfOnePurchase == b.profitOfOnePurchase && a.storageCosts == b.storageCosts
+               && a.inflation == b.inflation && a.deficitCoefficient == b.deficitCoefficient
+               && a.purchasePrice == b.purchasePrice;
+    }
+
+private:
+    const PlanRigor m_rigor;
+    const FftMode m_fftMode;
+    const unsigned m_threads;
+    std::unique_ptr<TaskCalculator> calculator;
+    TaskParameters m_params{};
+    GaussDestrParameters m_grid{};
+    int m_periodsNum = 0;
+    int m_dotsNum = 0;
+    std::vector<GaussDestrParameters> m_gaussVec;
+};
@@ -0,0 +1,112 @@
+#include "solveworker.h"
+
+#include <QStandardPaths>
+
+namespace {
+
+// The key solveProduct would use for the same solve (see refine for the grid limits).
+std::string cacheKey(const SolveRequest &request)
+{
+    Product product{"", request.params, request.gauss, request.forecast, request.cur_x};
+    SolveOptions options;
+    if (request.tolerance.enabled()) {
+        options.grid = request.tolerance;
+        options.grid.minDots = request.dotsNum;
+        options.grid.maxDots = std::max(request.tolerance.maxDots, request.dotsNum);
+    }
+    return solveCacheKey(product, request.periodsNum, request.dotsNum, FftMode::real, options);
+}
+
+}
+
+SolveWorker::SolveWorker()
+    : cache(size_t{64} << 20,
+            QStandardPaths::writableLocation(QStandardPaths::CacheLocation).toStdString() + "/solves")
+{
+}
+
+void SolveWorker::supersede(quint64 id)
+{
+    latest = id;
+}
+
+void SolveWorker::solve(SolveRequest request, quint64 id)
+{
+    if (id != latest) {
+        emit cancelled(id);
+        return;
+    }
+    const std::string key = cacheKey(request);
+    if (auto cached = cache.find(key)) {
+        emit finished(id, SolveResult{cached->y_max, cached->profit_max, cached->answer, {}, cached->grid.dotsNum, true});
+        return;
+    }
+    if (request.tolerance.enabled()) {
+        refine(std::move(request), id, key);
+        return;
+    }
+    session.solve(request.params, request.gauss, request.periodsNum, request.dotsNum, std::move(request.forecast),
+                  [this, id](int done){
+        emit progress(id, done, done + session.getCalculator()->getCurrentPeriod() + 1);
+        return id == latest;
+    });
+    if (id != latest) {
+        emit cancelled(id);
+        return;
+    }
+    TaskCalculator *calculator = session.getCalculator();
+    SolveResult result{calculator->getMaxY(), calculator->getMaxProfit(), calculator->getAnswer(request.cur_x),
+                       calculator->getStats(), request.dotsNum};
+    remember(key, result, request.cur_x);
+    emit finished(id, result);
+}
+
+// Grids of the refinement are solved from scratch; the session keeps the last fixed-grid solve.
+void SolveWorker::refine(SolveRequest request, quint64 id, const std::string &key)
+{
+    request.tolerance.minDots = request.dotsNum;
+    request.tolerance.maxDots = std::max(request.tolerance.maxDots, request.dotsNum);
+    GridRefinement refinement;
+    auto grid = gridDistribution(request.gauss, request.forecast);
+    refined = refineGrid(grid, request.tolerance, {request.cur_x}, refinement, [&](int dotsNum){
+        auto calculator = std::make_unique<TaskCalculator>(
+                request.params, grid, request.periodsNum,
+                std::make_shared<FftWorkspace>(dotsNum, PlanRigor::measure, FftMode::real, threads));
+        calculator->setThreads(threads);
+        calculator->setGaussVector(request.forecast);
+        return calculator;
+    }, [&](TaskCalculator &calculator){
+        int done = 0;
+        while (calculator.calcPeriod()) {
+            ++done;
+            emit progress(id, done, done + calculator.getCurrentPeriod() + 1);
+            if (id != latest) {
+                return false;
+            }
+        }
+        return true;
+    });
+    if (id != latest || !refined) {
+        emit cancelled(id);
+        return;
+    }
+    SolveResult result{refined->getMaxY(), refined->getMaxProfit(), refined->getAnswer(request.cur_x),
+                       refined->getStats(), refinement.dotsNum};
+    remember(key, result, request.cur_x);
+    emit finished(id, result);
+}
+
+void SolveWorker::remember(const std::string &key, const SolveResult &result, double cur_x)
+{
+    if (!result.answer) {
+        return;
+    }
+    const double order = result.answer->y - cur_x;
+    ProductResult product;
+    product.answer = result.answer;
+    product.order = order < 0.01 ? 0.0 : order;
+    product.y_max = result.y_max;
+    product.profit_max = result.profit_max;
+    product.grid.dotsNum = result.dotsNum;
+    cache.store(key, product);
+}
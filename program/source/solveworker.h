@@ -0,0 +1,71 @@
+#ifndef SOLVEWORKER_H
+#define SOLVEWORKER_H
+
+#include <QObject>
+
+#include "grid_refinement.h"
+#include "solve_cache.h"
+#include "solver_session.h"
+
+#include <atomic>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <vector>
+
+struct SolveRequest {
+    TaskParameters params;
+    GaussDestrParameters gauss;
+    int periodsNum;
+    int dotsNum;
+    std::vector<GaussDestrParameters> forecast;
+    double cur_x;
+    GridTolerance tolerance{};       // when enabled, dotsNum is only the smallest grid tried
+};
+
+struct SolveResult {
+    std::vector<double> y_max;
+    std::vector<double> profit_max;
+    std::optional<Answer> answer;
+    SolveStats stats;
+    int dotsNum = 0;
+    bool cached = false;
+};
+
+Q_DECLARE_METATYPE(SolveResult)
+
+// Runs solves on the thread it lives on. Every request carries an id; a request
+// stops at the next period boundary as soon as a newer id is announced through
+// supersede(), which may be called from any thread.
+class SolveWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    // Results are cached in memory and under the user's cache directory, so reopening the
+    // application with the same inputs does not solve again.
+    SolveWorker();
+
+    void supersede(quint64 id);
+
+public slots:
+    void solve(SolveRequest request, quint64 id);
+
+signals:
+    void progress(quint64 id, int done, int total);
+    void finished(quint64 id, SolveResult result);
+    void cancelled(quint64 id);
+
+private:
+    void refine(SolveRequest request, quint64 id, const std::string &key);
+    void remember(const std::string &key, const SolveResult &result, double cur_x);
+
+private:
+    const unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    SolverSession session{PlanRigor::measure, FftMode::real, threads};
+    std::unique_ptr<TaskCalculator> refined;
+    std::atomic<quint64> latest{0};
+    SolveCache cache;
+};
+
+#endif // SOLVEWORKER_H
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+
+// Failures of the running test executable; main returns failures() != 0.
+inline int &failures() {
+    static int count = 0;
+    return count;
+}
+
+// Passes when error <= tolerance (a NaN error fails); prints one line either way.
+inline void expectAtMost(const std::string &what, double error, double tolerance) {
+    const bool ok = error <= tolerance;
+    std::printf("%s %-60s error %.3e, tolerance %.3e\n", ok ? "ok  " : "FAIL", what.c_str(), error, tolerance);
+    failures() += !ok;
+}
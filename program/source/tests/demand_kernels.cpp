@@ -0,0 +1,229 @@
+// The demand policies of demand.h, DemandIntegrator and DemandConvolution against the original
+// normal-demand solver: ExplicitIntegrator::calculate (the scalar erf/exp expression) and the
+// circular sum GaussConvolution computed by FFT.
+
+#include "check.h"
+#include "manager.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+const TaskParameters params{50.0, 2.0, 0.97, 10.0, 30.0};
+
+// The solver's grid for a distribution (see BasicTaskCalculator).
+std::vector<double> gridFor(GaussDestrParameters gauss, size_t n) {
+    return linspace(-(gauss.mean + 3.0 * gauss.sigma), gauss.mean + 3.0 * gauss.sigma, n);
+}
+
+// The stocks the expected profit is evaluated at: the grid points from n / 2 on, all positive.
+// (Below zero ExplicitIntegrator extrapolates the erf expression, the policies clamp to no leftover.)
+std::vector<double> stocksFor(GaussDestrParameters gauss, size_t n) {
+    const auto x = gridFor(gauss, n);
+    return std::vector<double>(x.begin() + static_cast<std::ptrdiff_t>(n / 2), x.end());
+}
+
+double maxAbs(const std::vector<double> &values) {
+    double result = 0.0;
+    for (double it: values) {
+        result = std::max(result, std::abs(it));
+    }
+    return result;
+}
+
+double maxDifference(const std::vector<double> &a, const std::vector<double> &b) {
+    double result = 0.0;
+    for (size_t i = 0; i < a.size(); ++i) {
+        result = std::max(result, std::abs(a[i] - b[i]));
+    }
+    return result;
+}
+
+// ExplicitIntegrator's scalar path over the grid, the reference every integrator is held to.
+std::vector<double> explicitProfit(GaussDestrParameters gauss, const std::vector<double> &y) {
+    ExplicitIntegrator integrator(params, gauss);
+    std::vector<double> result(y.size());
+    for (size_t i = 0; i < y.size(); ++i) {
+        result[i] = integrator.calculate(y[i]);
+    }
+    return result;
+}
+
+template<typename Demand>
+std::vector<double> demandProfit(GaussDestrParameters gauss, const std::vector<double> &y, Demand demand = Demand{}) {
+    DemandIntegrator<Demand> integrator(params, gauss, std::move(demand));
+    std::vector<double> result(y.size());
+    integrator.calculate(y.data(), result.data(), y.size());
+    return result;
+}
+
+// Sorted standard normal quantiles at (i + 0.5) / count, by bisection on erfc.
+std::vector<double> normalQuantiles(size_t count) {
+    std::vector<double> result(count);
+    for (size_t i = 0; i < count; ++i) {
+        const double p = (static_cast<double>(i) + 0.5) / static_cast<double>(count);
+        double low = -10.0;
+        double high = 10.0;
+        for (int step = 0; step < 100; ++step) {
+            const double mid = (low + high) / 2.0;
+            (0.5 * std::erfc(-mid / std::sqrt(2.0)) < p ? low : high) = mid;
+        }
+        result[i] = (low + high) / 2.0;
+    }
+    return result;
+}
+
+void integrators() {
+    for (GaussDestrParameters gauss: {GaussDestrParameters{100.0, 20.0}, GaussDestrParameters{5.0, 3.0},
+                                      GaussDestrParameters{1000.0, 50.0}}) {
+        char at[64];
+        std::snprintf(at, sizeof(at), " at mean %g, sigma %g", gauss.mean, gauss.sigma);
+        const auto y = stocksFor(gauss, 8192);
+        const auto reference = explicitProfit(gauss, y);
+        const double scale = maxAbs(reference);
+
+        ExplicitIntegrator integrator(params, gauss);
+        std::vector<double> vectorized(y.size());
+        integrator.calculate(y.data(), vectorized.data(), y.size());
+        expectAtMost(std::string("ExplicitIntegrator, vectorized kernels") + at,
+                     maxDifference(vectorized, reference) / scale, 1e-13);
+
+        expectAtMost(std::string("DemandIntegrator<GaussianDemand>") + at,
+                     maxDifference(demandProfit<GaussianDemand>(gauss, y), reference) / scale, 1e-13);
+    }
+
+    // The other policies, where they approach the normal distribution.
+    const GaussDestrParameters gauss{1000.0, 10.0};
+    const auto y = stocksFor(gauss, 8192);
+    const auto reference = explicitProfit(gauss, y);
+    const double scale = maxAbs(reference);
+    expectAtMost("DemandIntegrator<LognormalDemand>, cv 0.01 vs normal",
+                 maxDifference(demandProfit<LognormalDemand>(gauss, y), reference) / scale, 1e-5);
+    const GaussDestrParameters counts{10000.0, 150.0};
+    const auto yCounts = stocksFor(counts, 8192);
+    const auto referenceCounts = explicitProfit(counts, yCounts);
+    expectAtMost("DemandIntegrator<NegativeBinomialDemand>, mean 1e4 vs normal",
+                 maxDifference(demandProfit<NegativeBinomialDemand>(counts, yCounts), referenceCounts)
+                 / maxAbs(referenceCounts), 1e-5);
+    EmpiricalDemand empirical(makeEmpiricalShape(normalQuantiles(20001)));
+    expectAtMost("DemandIntegrator<EmpiricalDemand>, normal quantiles vs normal",
+                 maxDifference(demandProfit(gauss, y, empirical), reference) / scale, 1e-7);
+}
+
+// Kernel cells over the non-negative half of the grid must hold the distribution the
+// integrator's moments describe: total mass 1 and the policy's mean.
+template<typename Demand>
+void kernelMoments(const std::string &name, GaussDestrParameters gauss, Demand demand = Demand{}) {
+    demand.setParams(gauss);
+    const double step = gauss.sigma / 64.0;
+    double mass = 0.0;
+    double mean = 0.0;
+    for (size_t k = 0; k * step <= gauss.mean + 20.0 * gauss.sigma; ++k) {
+        const double d = (static_cast<double>(k) + 0.5) * step;
+        const double cell = demand.kernel(d, step, k == 0) * step;
+        mass += cell;
+        mean += cell * d;
+    }
+    expectAtMost(name + " kernel mass", std::abs(mass - 1.0), 1e-9);
+    expectAtMost(name + " kernel mean vs mean(), in steps", std::abs(mean - demand.mean()) / step, 1.0);
+}
+
+// GaussConvolution's sum, result[i] = step * sum over j >= n / 2 of weight[j] * source[(i - j) mod n],
+// evaluated directly.
+std::vector<double> circularConvolution(const std::vector<double> &weight, const std::vector<double> &source,
+                                        double step) {
+    const size_t n = source.size();
+    std::vector<double> result(n / 2, 0.0);
+    for (size_t i = 0; i < n / 2; ++i) {
+        for (size_t j = n / 2; j < n; ++j) {
+            result[i] += weight[j] * source[(i + n - j) % n];
+        }
+        result[i] *= step;
+    }
+    return result;
+}
+
+template<typename Demand>
+void convolutions(const std::string &name, GaussDestrParameters gauss, const std::vector<double> &weight,
+                  Demand demand = Demand{}) {
+    const size_t n = weight.size();
+    const auto x = gridFor(gauss, n);
+    const double step = x[1] - x[0];
+    // A value function shape: concave in the stock, plus a ripple the kernel has to smooth.
+    std::vector<double> source(n);
+    for (size_t i = 0; i < n; ++i) {
+        source[i] = 40.0 * x[i] - 0.05 * x[i] * x[i] + 300.0 * std::sin(0.05 * static_cast<double>(i));
+    }
+    const auto reference = circularConvolution(weight, source, step);
+    const double scale = maxAbs(source);
+
+    struct Case {
+        const char *name;
+        FftMode mode;
+        ConvolutionMethod method;
+        double tolerance;
+    };
+    for (const Case &it: {Case{"real FFT", FftMode::real, ConvolutionMethod::fft, 1e-12},
+                          Case{"complex FFT", FftMode::complex, ConvolutionMethod::fft, 1e-12},
+                          Case{"direct", FftMode::real, ConvolutionMethod::direct, 1e-12}}) {
+        DemandConvolution<Demand> convolution(gauss.mean, gauss.sigma, x,
+                                              std::make_shared<FftWorkspace>(n, PlanRigor::estimate, it.mode), demand);
+        convolution.setMethod(it.method);
+        const auto result = convolution.calculate(source);
+        expectAtMost(name + ", " + it.name, maxDifference(result, reference) / scale, it.tolerance);
+    }
+}
+
+template<typename Demand>
+std::vector<double> policyWeights(GaussDestrParameters gauss, size_t n, Demand demand = Demand{}) {
+    demand.setParams(gauss);
+    const auto x = gridFor(gauss, n);
+    const double step = x[1] - x[0];
+    std::vector<double> result(n, 0.0);
+    for (size_t j = n / 2; j < n; ++j) {
+        result[j] = demand.kernel(x[j], step, j == n / 2);
+    }
+    return result;
+}
+
+// The kernel series of the original GaussConvolution::makeExpSeries, divided by sigma^2 as its coefficient was.
+std::vector<double> baselineGaussWeights(GaussDestrParameters gauss, size_t n) {
+    const auto x = gridFor(gauss, n);
+    const double M = gauss.mean;
+    const double s = gauss.sigma;
+    std::vector<double> result(n, 0.0);
+    for (size_t j = n / 2; j < n; ++j) {
+        result[j] = std::exp(-(M - x[j]) * (M - x[j]) / (2.0 * s * s)) * (s / std::sqrt(2.0 * M_PI)) / (s * s);
+    }
+    return result;
+}
+
+}
+
+int main() {
+    integrators();
+
+    const GaussDestrParameters gauss{100.0, 20.0};
+    const auto shape = makeEmpiricalShape({3.0, 5.0, 6.0, 8.0, 8.0, 13.0, 21.0, 40.0});
+    kernelMoments<GaussianDemand>("GaussianDemand", {100.0, 10.0});
+    kernelMoments<LognormalDemand>("LognormalDemand", {100.0, 30.0});
+    kernelMoments<NegativeBinomialDemand>("NegativeBinomialDemand", {100.0, 30.0});
+    kernelMoments<NegativeBinomialDemand>("NegativeBinomialDemand, Poisson", {100.0, 8.0});
+    kernelMoments("EmpiricalDemand", gauss, EmpiricalDemand(shape));
+
+    const size_t n = 1024;
+    convolutions<GaussianDemand>("GaussConvolution vs the original kernel", gauss, baselineGaussWeights(gauss, n));
+    convolutions<LognormalDemand>("DemandConvolution<LognormalDemand>", gauss,
+                                  policyWeights<LognormalDemand>(gauss, n));
+    convolutions<NegativeBinomialDemand>("DemandConvolution<NegativeBinomialDemand>", gauss,
+                                         policyWeights<NegativeBinomialDemand>(gauss, n));
+    convolutions("DemandConvolution<EmpiricalDemand>", gauss, policyWeights(gauss, n, EmpiricalDemand(shape)),
+                 EmpiricalDemand(shape));
+    return failures() != 0;
+}
@@ -0,0 +1,98 @@
+// Precision::mixed and Precision::single solves against the full precision solver, held to the
+// bounds documented at Precision: y_max within 0.013 sigma or one grid step, profits within 1e-6
+// relative over 12 periods and 4e-6 over 60.
+
+#include "check.h"
+#include "grid_refinement.h"
+#include "manager.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Case {
+    TaskParameters params;
+    GaussDestrParameters gauss;
+    double stock;
+};
+
+struct Solve {
+    std::vector<double> y_max;
+    std::vector<double> profit_max;
+    Answer answer;
+};
+
+template<typename Calculator>
+Solve solve(const Case &task, int periodsNum, int dotsNum) {
+    Calculator calculator(task.params, task.gauss, periodsNum, dotsNum);
+    while (calculator.calcPeriod()) {
+    }
+    const auto answer = calculator.getAnswer(task.stock);
+    return {calculator.getMaxY(), calculator.getMaxProfit(), answer.value_or(Answer{})};
+}
+
+template<typename Calculator>
+void compare(const char *mode, const Case &task, const Solve &full, int periodsNum, int dotsNum) {
+    const Solve reduced = solve<Calculator>(task, periodsNum, dotsNum);
+    double goods = std::abs(reduced.answer.y - full.answer.y);
+    double money = std::abs(reduced.answer.MaxProfit - full.answer.MaxProfit);
+    double profitScale = std::abs(full.answer.MaxProfit);
+    for (size_t k = 0; k < full.y_max.size(); ++k) {
+        goods = std::max(goods, std::abs(reduced.y_max[k] - full.y_max[k]));
+        money = std::max(money, std::abs(reduced.profit_max[k] - full.profit_max[k]));
+        profitScale = std::max(profitScale, std::abs(full.profit_max[k]));
+    }
+    char at[96];
+    std::snprintf(at, sizeof(at), " at mean %g, sigma %g, 2^%d points, %d periods", task.gauss.mean,
+                  task.gauss.sigma, static_cast<int>(std::log2(dotsNum)), periodsNum);
+    // A step, plus the float rounding of the grid points in single precision.
+    const double step = gridStep(task.gauss, dotsNum) / task.gauss.sigma;
+    expectAtMost(std::string(mode) + " y_max, in sigmas" + at, goods / task.gauss.sigma,
+                 std::max(0.013, step * (1.0 + 1e-3)));
+    expectAtMost(std::string(mode) + " profits, relative" + at, money / profitScale, periodsNum <= 12 ? 1e-6 : 4e-6);
+}
+
+// The float expectedProfit kernels (shortened erfc series and exp polynomial) against the double ones.
+void floatIntegrator(const Case &task) {
+    ExplicitIntegrator integrator(task.params, task.gauss);
+    const auto y = linspace(0.0, task.gauss.mean + 3.0 * task.gauss.sigma, size_t{4096});
+    std::vector<double> reference(y.size());
+    integrator.calculate(y.data(), reference.data(), y.size());
+    const std::vector<float> yFloat(y.begin(), y.end());
+    std::vector<float> reduced(y.size());
+    integrator.calculate(yFloat.data(), reduced.data(), y.size());
+    double error = 0.0;
+    double scale = 0.0;
+    for (size_t i = 0; i < y.size(); ++i) {
+        error = std::max(error, std::abs(static_cast<double>(reduced[i]) - reference[i]));
+        scale = std::max(scale, std::abs(reference[i]));
+    }
+    char at[64];
+    std::snprintf(at, sizeof(at), " at mean %g, sigma %g", task.gauss.mean, task.gauss.sigma);
+    expectAtMost(std::string("float ExplicitIntegrator, relative") + at, error / scale, 1e-6);
+}
+
+}
+
+int main() {
+    const Case cases[] = {
+            {{50.0, 2.0, 0.97, 10.0, 30.0}, {100.0, 20.0}, 40.0},
+            {{8.0, 0.5, 0.99, 3.0, 5.0}, {12.0, 6.0}, 0.0},
+            {{40.0, 5.0, 0.95, 60.0, 100.0}, {1000.0, 150.0}, 500.0},
+    };
+    for (const Case &task: cases) {
+        floatIntegrator(task);
+        for (int periodsNum: {12, 60}) {
+            for (int dotsNum: {1 << 10, 1 << 13}) {
+                const Solve full = solve<TaskCalculator>(task, periodsNum, dotsNum);
+                compare<MixedTaskCalculator>("mixed", task, full, periodsNum, dotsNum);
+                compare<SingleTaskCalculator>("single", task, full, periodsNum, dotsNum);
+            }
+        }
+    }
+    return failures() != 0;
+}
@@ -0,0 +1,82 @@
+"""Smoke test of the purchase_forecast module (PURCHASE_FORECAST_PYTHON): results against the
+C++ solver's invariants, the zero-copy grid view, and solves that release the GIL.
+
+Not registered with ctest until it has been seen to pass against a built module; run it by hand
+with the module's build directory on the path:
+    PYTHONPATH=<build dir> python3 tests/python_module.py
+"""
+
+import threading
+import time
+
+import numpy as np
+
+import purchase_forecast as pf
+
+
+def parse_periods():
+    day = 86400
+    dates = np.arange(120, dtype=np.int64) * day
+    sales = 10.0 + np.arange(120) % 3
+    forecast = pf.parsePeriods(dates, sales, pf.Period.week)
+    # 17 whole weeks; the unfinished 18th is left out.
+    assert forecast.shape == (17, 2), forecast.shape
+    assert np.allclose(forecast[:, 0], [sales[7 * k:7 * k + 7].sum() for k in range(17)])
+    assert (forecast[:, 1] > 0).all()
+    return forecast
+
+
+def solve(forecast):
+    params = pf.TaskParameters(30, 50, 2, 10, 0.97)
+    calculator = pf.TaskCalculator(params, mean=100, sigma=20, periodsNum=12)
+    calculator.setGaussVector(forecast[:11])
+    calculator.solve()
+    assert calculator.getCurrentPeriod() < 0
+    level, period_profit, total_profit = calculator.getAnswer(40)
+    assert level >= 40
+    assert total_profit >= period_profit
+    levels, _, totals = calculator.getAnswers(np.array([40.0, np.nan]))
+    assert levels[0] == level and totals[0] == total_profit
+    assert np.isnan(levels[1])
+    assert calculator.getMaxY().shape == (11,)
+
+    grid = calculator.getGrid()
+    assert grid.base is calculator, "getGrid should be a view of the calculator"
+    assert not grid.flags.writeable and not grid.flags.owndata
+    assert np.shares_memory(grid, calculator.getGrid())
+    assert calculator.getValueFunction(1).shape == grid.shape
+    # The view keeps the calculator alive.
+    del calculator
+    assert grid[0] < 0 < grid[-1]
+
+
+def releases_gil():
+    params = pf.TaskParameters(30, 50, 2, 10, 0.97)
+    calculator = pf.TaskCalculator(params, mean=100, sigma=20, periodsNum=60, dotsNum=1 << 16)
+    span = {}
+
+    def run():
+        span["start"] = time.perf_counter()
+        calculator.solve()
+        span["end"] = time.perf_counter()
+
+    worker = threading.Thread(target=run)
+    ticks = []
+    worker.start()
+    while worker.is_alive():
+        ticks.append(time.perf_counter())
+        time.sleep(0.0005)
+    worker.join()
+    # Python code runs only while its thread holds the GIL, so ticks during the solve prove it was released.
+    inside = sum(span["start"] < tick < span["end"] for tick in ticks)
+    assert inside > 0, "solve() held the GIL"
+
+
+def main():
+    solve(parse_periods())
+    releases_gil()
+    print("ok")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fork-join loops inside one solve. Unlike WorkStealingPool the threads outlive a call,
+// so splitting a grid loop of every period costs a wake-up rather than starting threads.
+// The calling thread takes part; run() must not be called from two threads at once.
+// The task is passed by reference, not wrapped in a std::function, so a call does not allocate.
+class ThreadTeam {
+public:
+    // threads counts the caller; 0 means one per core.
+    explicit ThreadTeam(unsigned threads = 0)
+            : threadsNum(threads ? threads : std::max(1u, std::thread::hardware_concurrency())) {
+        for (unsigned w = 1; w < threadsNum; ++w) {
+            workers.emplace_back([this] {
+                work();
+            });
+        }
+    }
+
+    ThreadTeam(const ThreadTeam &) = delete;
+    ThreadTeam &operator=(const ThreadTeam &) = delete;
+
+    ~ThreadTeam() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto &worker: workers) {
+            worker.join();
+        }
+    }
+
+    [[nodiscard]] unsigned size() const {
+        return threadsNum;
+    }
+
+    // task(index) is called once for each index in [0, count); returns when all calls have.
+    template<typename Task>
+    void run(size_t count, const Task &task) {
+        if (workers.empty() || count < 2) {
+            for (size_t i = 0; i < count; ++i) {
+                task(i);
+            }
+            return;
+        }
+        const Job job{&task, [](const void *it, size_t index) {
+            (*static_cast<const Task *>(it))(index);
+        }};
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            current = &job;
+            total = count;
+            next = 0;
+            busy = static_cast<unsigned>(workers.size());
+            ++generation;
+        }
+        wake.notify_all();
+        take(job, count);
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] {
+            return busy == 0;
+        });
+        current = nullptr;
+    }
+
+private:
+    struct Job {
+        const void *task;
+        void (*call)(const void *, size_t);
+    };
+
+    void take(const Job &job, size_t count) {
+        for (size_t i = next++; i < count; i = next++) {
+            job.call(job.task, i);
+        }
+    }
+
+    void work() {
+        uint64_t seen = 0;
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            wake.wait(lock, [&] {
+                return stopping || generation != seen;
+            });
+            if (stopping) {
+                return;
+            }
+            seen = generation;
+            const Job *job = current;
+            const size_t count = total;
+            lock.unlock();
+            take(*job, count);
+            lock.lock();
+            if (--busy == 0) {
+                done.notify_one();
+            }
+        }
+    }
+
+private:
+    const unsigned threadsNum;
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    const Job *current = nullptr;
+    size_t total = 0;
+    std::atomic<size_t> next{0};
+    unsigned busy = 0;
+    uint64_t generation = 0;
+    bool stopping = false;
+};
+
+// body(begin, end) over consecutive ranges covering [0, count), ranges of at least grain items
+// spread over the team; a single call without a team or with too little work.
+template<typename Body>
+void forChunks(ThreadTeam *team, size_t count, size_t grain, const Body &body) {
+    const size_t chunks = team ? std::min<size_t>(team->size() * 4, count / std::max<size_t>(grain, 1)) : 0;
+    if (chunks < 2) {
+        body(size_t{0}, count);
+        return;
+    }
+    team->run(chunks, [&](size_t chunk) {
+        body(count * chunk / chunks, count * (chunk + 1) / chunks);
+    });
+}
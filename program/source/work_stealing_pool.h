@@ -0,0 +1,77 @@
+#pragma once
+
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+// Runs a fixed number of independent tasks on a set of workers. Every worker
+// owns a deque of task indices, takes work from its back and, once it is empty,
+// steals from the front of the other workers' deques.
+class WorkStealingPool {
+public:
+    explicit WorkStealingPool(unsigned threads = 0)
+            : threadsNum(threads ? threads : std::max(1u, std::thread::hardware_concurrency())) {
+    }
+
+    [[nodiscard]] unsigned size() const {
+        return threadsNum;
+    }
+
+    // task(index, worker) is called once for each index in [0, count); worker is in [0, size()).
+    template<typename Task>
+    void run(size_t count, Task task) {
+        if (count == 0) {
+            return;
+        }
+        std::vector<Queue> queues(threadsNum);
+        for (size_t i = 0; i < count; ++i) {
+            queues[i * threadsNum / count].tasks.push_back(i);
+        }
+        std::vector<std::thread> workers;
+        workers.reserve(threadsNum);
+        for (unsigned w = 0; w < threadsNum; ++w) {
+            workers.emplace_back([&queues, &task, w] {
+                while (auto index = next(queues, w)) {
+                    task(*index, w);
+                }
+            });
+        }
+        for (auto &worker: workers) {
+            worker.join();
+        }
+    }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<size_t> tasks;
+    };
+
+    static std::optional<size_t> next(std::vector<Queue> &queues, unsigned worker) {
+        {
+            auto &own = queues[worker];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.tasks.empty()) {
+                size_t index = own.tasks.back();
+                own.tasks.pop_back();
+                return index;
+            }
+        }
+        for (size_t k = 1; k < queues.size(); ++k) {
+            auto &victim = queues[(worker + k) % queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty()) {
+                size_t index = victim.tasks.front();
+                victim.tasks.pop_front();
+                return index;
+            }
+        }
+        return std::nullopt;
+    }
+
+private:
+    const unsigned threadsNum;
+};